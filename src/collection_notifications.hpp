@@ -51,6 +51,16 @@ private:
     size_t m_token;
 };
 
+// How urgently the notifications for a collection are needed. When a commit
+// invalidates several collections, the ones with interactive callbacks are
+// recalculated and made ready for delivery before any background or bulk ones,
+// so that a thread displaying them doesn't have to wait for unrelated work.
+enum class NotificationPriority : unsigned char {
+    Interactive,
+    Background,
+    Bulk,
+};
+
 struct CollectionChangeSet {
     struct Move {
         size_t from;
@@ -95,9 +105,83 @@ struct CollectionChangeSet {
     }
 };
 
+// A read-only view of the changes to a collection, passed to callbacks which
+// take one instead of a CollectionChangeSet. Rather than having separate
+// IndexSets of the modified indices in the old and new collections built for
+// it, it computes them while iterating, which avoids allocating several large
+// IndexSets for callbacks which only need to count or scan the changes to a
+// very large collection. It refers to data owned by the notifier and is only
+// valid for the duration of the callback.
+class CollectionChangeView {
+public:
+    using Move = CollectionChangeSet::Move;
+
+    // Used by the notifiers. If `lazy` is set, `changes.modifications_new`
+    // holds the modified indices in the new collection which may include
+    // inserted indices, and `changes.modifications` is unused.
+    explicit CollectionChangeView(CollectionChangeSet const& changes, bool lazy=false) noexcept
+    : m_changes(changes), m_lazy(lazy) { }
+
+    IndexSet const& deletions() const noexcept { return m_changes.deletions; }
+    IndexSet const& insertions() const noexcept { return m_changes.insertions; }
+    std::vector<Move> const& moves() const noexcept { return m_changes.moves; }
+    std::vector<IndexSet> const& columns() const noexcept { return m_changes.columns; }
+
+    bool empty() const noexcept { return m_changes.empty(); }
+
+    // The number of modified objects
+    size_t modification_count() const
+    {
+        if (!m_lazy)
+            return m_changes.modifications.count();
+        size_t count = 0;
+        for_each_modification([&](size_t, size_t) { ++count; });
+        return count;
+    }
+
+    // Call `fn(old_index, new_index)` for each modified object, in order
+    template<typename Fn>
+    void for_each_modification(Fn&& fn) const;
+
+private:
+    CollectionChangeSet const& m_changes;
+    bool m_lazy;
+};
+
+template<typename Fn>
+void CollectionChangeView::for_each_modification(Fn&& fn) const
+{
+    if (!m_lazy) {
+        auto old_it = m_changes.modifications.as_indexes().begin();
+        for (auto new_ndx : m_changes.modifications_new.as_indexes())
+            fn(*old_it++, new_ndx);
+        return;
+    }
+
+    // Walk the insertions and deletions alongside the modifications to map
+    // each new index back to the old one, skipping newly inserted objects
+    auto const& insertions = m_changes.insertions;
+    auto const& deletions = m_changes.deletions;
+    auto ins = insertions.begin();
+    auto del = deletions.begin();
+    size_t inserted_before = 0, deleted_before = 0;
+    for (auto new_ndx : m_changes.modifications_new.as_indexes()) {
+        for (; ins != insertions.end() && ins->second <= new_ndx; ++ins)
+            inserted_before += ins->second - ins->first;
+        if (ins != insertions.end() && ins->first <= new_ndx)
+            continue;
+
+        size_t unshifted = new_ndx - inserted_before;
+        for (; del != deletions.end() && del->first <= unshifted + deleted_before; ++del)
+            deleted_before += del->second - del->first;
+        fn(unshifted + deleted_before, new_ndx);
+    }
+}
+
 // A type-erasing wrapper for the callback for collection notifications. Can be
 // constructed with either any callable compatible with the signature
-// `void (CollectionChangeSet, std::exception_ptr)`, an object with member
+// `void (CollectionChangeSet, std::exception_ptr)`, a callable compatible with
+// `void (CollectionChangeView const&, std::exception_ptr)`, an object with member
 // functions `void before(CollectionChangeSet)`, `void after(CollectionChangeSet)`,
 // `void error(std::exception_ptr)`, or a pointer to such an object. If a pointer
 // is given, the caller is responsible for ensuring that the pointed-to object
@@ -120,23 +204,54 @@ public:
 
     void before(CollectionChangeSet const& c) { m_impl->before(c); }
     void after(CollectionChangeSet const& c) { m_impl->after(c); }
+    void after(CollectionChangeView const& c) { m_impl->after_view(c); }
     void error(std::exception_ptr e) { m_impl->error(e); }
 
+    // Whether the callback takes a CollectionChangeView, and so doesn't need
+    // a complete CollectionChangeSet to be built for it
+    bool wants_view() const { return m_impl->wants_view(); }
+
     explicit operator bool() const { return !!m_impl; }
 
 private:
     struct Base {
         virtual void before(CollectionChangeSet const&)=0;
         virtual void after(CollectionChangeSet const&)=0;
+        virtual void after_view(CollectionChangeView const& c) { after(to_change_set(c)); }
         virtual void error(std::exception_ptr)=0;
+        virtual bool wants_view() const { return false; }
     };
 
+    static CollectionChangeSet to_change_set(CollectionChangeView const& c)
+    {
+        CollectionChangeSet changes{c.deletions(), c.insertions(), {}, {}, c.moves(), c.columns()};
+        c.for_each_modification([&](size_t old_ndx, size_t new_ndx) {
+            changes.modifications.add(old_ndx);
+            changes.modifications_new.add(new_ndx);
+        });
+        return changes;
+    }
+
     template<typename Callback, typename = decltype(std::declval<Callback>()(CollectionChangeSet(), std::exception_ptr()))>
     std::shared_ptr<Base> make_impl(Callback cb)
     {
         return std::make_shared<Impl<Callback>>(std::move(cb));
     }
 
+    template<typename Callback, typename = void>
+    struct TakesChangeSet : std::false_type { };
+    template<typename Callback>
+    struct TakesChangeSet<Callback, decltype(void(std::declval<Callback>()(CollectionChangeSet(), std::exception_ptr())))>
+    : std::true_type { };
+
+    // Callables which accept both forms are given a CollectionChangeSet
+    template<typename Callback, typename = decltype(std::declval<Callback>()(std::declval<CollectionChangeView const&>(), std::exception_ptr())),
+             typename = std::enable_if_t<!TakesChangeSet<Callback>::value>, typename = void>
+    std::shared_ptr<Base> make_impl(Callback cb)
+    {
+        return std::make_shared<ViewImpl<Callback>>(std::move(cb));
+    }
+
     template<typename Callback, typename = decltype(std::declval<Callback>().after(CollectionChangeSet())), typename = void>
     std::shared_ptr<Base> make_impl(Callback cb)
     {
@@ -158,6 +273,16 @@ private:
         void error(std::exception_ptr error) override { impl({}, error); }
     };
     template<typename T>
+    struct ViewImpl : public Base {
+        T impl;
+        ViewImpl(T impl) : impl(std::move(impl)) { }
+        void before(CollectionChangeSet const&) override { }
+        void after(CollectionChangeSet const& change) override { impl(CollectionChangeView(change), {}); }
+        void after_view(CollectionChangeView const& change) override { impl(change, {}); }
+        void error(std::exception_ptr error) override { impl(CollectionChangeView(CollectionChangeSet{}), error); }
+        bool wants_view() const override { return true; }
+    };
+    template<typename T>
     struct Impl2 : public Base {
         T impl;
         Impl2(T impl) : impl(std::move(impl)) { }
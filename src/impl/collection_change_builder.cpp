@@ -22,6 +22,7 @@
 #include <algorithm>
 
 #include <algorithm>
+#include <limits>
 
 using namespace realm;
 using namespace realm::_impl;
@@ -64,17 +65,41 @@ void CollectionChangeBuilder::merge(CollectionChangeBuilder&& c)
 
     // First update any old moves
     if (!c.moves.empty() || !c.deletions.empty() || !c.insertions.empty()) {
+        // Each old move needs to look up the new move (if any) of its
+        // destination. Scanning for it is fine for a handful of moves, but
+        // makes merging two changesets with many moves each quadratic, so
+        // past that index the new moves by source row. Each row can only be
+        // the source of one move so the index is unique.
+        util::FlatIndexMap move_index;
+        bool use_index = !moves.empty() && c.moves.size() > 16;
+        if (use_index) {
+            for (size_t i = 0; i < c.moves.size(); ++i)
+                move_index[c.moves[i].from] = i;
+        }
+        auto find_move_from = [&](size_t row) {
+            if (!use_index) {
+                return find_if(begin(c.moves), end(c.moves), [&](auto const& m) {
+                    return row == m.from;
+                });
+            }
+            auto it = move_index.find(row);
+            return it == move_index.end() ? end(c.moves) : begin(c.moves) + it->second;
+        };
+
         auto it = std::remove_if(begin(moves), end(moves), [&](auto& old) {
             // Check if the moved row was moved again, and if so just update the destination
-            auto it = find_if(begin(c.moves), end(c.moves), [&](auto const& m) {
-                return old.to == m.from;
-            });
+            auto it = find_move_from(old.to);
             if (it != c.moves.end()) {
                 for_each_col([&](auto& col, auto& other) {
                     if (col.contains(it->from))
                         other.add(it->to);
                 });
                 old.to = it->to;
+                if (use_index) {
+                    move_index.erase(it->from);
+                    if (&*it != &c.moves.back())
+                        move_index[c.moves.back().from] = it - begin(c.moves);
+                }
                 *it = c.moves.back();
                 c.moves.pop_back();
                 return false;
@@ -208,20 +233,8 @@ void CollectionChangeBuilder::insert(size_t index, size_t count, bool track_move
     if (m_move_mapping.empty())
         return;
 
-    // m_move_mapping is new_ndx -> old_ndx, so updating the keys requires
-    // deleting and re-inserting at the new index
-    std::vector<std::pair<size_t, size_t>> shifted;
-    for (auto it = m_move_mapping.begin(); it != m_move_mapping.end(); ) {
-        if (it->first >= index) {
-            shifted.emplace_back(it->first + count, it->second);
-            it = m_move_mapping.erase(it);
-        }
-        else {
-            ++it;
-        }
-    }
-    for (auto& pair : shifted)
-        m_move_mapping.insert(pair);
+    // m_move_mapping is new_ndx -> old_ndx, so the keys need to be updated
+    m_move_mapping.shift_keys(index, count);
 }
 
 void CollectionChangeBuilder::erase(size_t index)
@@ -345,8 +358,9 @@ void CollectionChangeBuilder::move_over(size_t row_ndx, size_t last_row, bool tr
     if (last_is_insertion) {
         auto it = m_move_mapping.find(last_row);
         if (it != m_move_mapping.end() && it->first == last_row) {
-            m_move_mapping[row_ndx] = it->second;
+            auto original = it->second;
             m_move_mapping.erase(it);
+            m_move_mapping[row_ndx] = original;
             last_was_already_moved = true;
         }
     }
@@ -419,8 +433,8 @@ void CollectionChangeBuilder::swap(size_t ndx_1, size_t ndx_2, bool track_moves)
 
     auto move_1 = m_move_mapping.find(ndx_1);
     auto move_2 = m_move_mapping.find(ndx_2);
-    bool have_move_1 = move_1 != end(m_move_mapping) && move_1->first == ndx_1;
-    bool have_move_2 = move_2 != end(m_move_mapping) && move_2->first == ndx_2;
+    bool have_move_1 = move_1 != m_move_mapping.end() && move_1->first == ndx_1;
+    bool have_move_2 = move_2 != m_move_mapping.end() && move_2->first == ndx_2;
     if (have_move_1 && have_move_2) {
         // both are already moves, so just swap the destinations
         std::swap(move_1->second, move_2->second);
@@ -463,8 +477,9 @@ void CollectionChangeBuilder::subsume(size_t old_ndx, size_t new_ndx, bool track
     // If the source row was already moved, update the existing move
     auto it = m_move_mapping.find(old_ndx);
     if (it != m_move_mapping.end() && it->first == old_ndx) {
-        m_move_mapping[new_ndx] = it->second;
+        auto original = it->second;
         m_move_mapping.erase(it);
+        m_move_mapping[new_ndx] = original;
     }
     // otherwise add a new move unless it was a new insertion
     else if (!insertions.contains(old_ndx)) {
@@ -503,13 +518,54 @@ void CollectionChangeBuilder::move_column(size_t from, size_t to)
 }
 
 namespace {
+// The row and table view indices used while calculating changes are stored as
+// `Index`, which is uint32_t whenever every index fits in one. This halves the
+// size of the arrays which are sorted and searched on 64-bit platforms.
+template<typename Index>
+constexpr Index npos = Index(-1);
+
+template<typename Index>
 struct RowInfo {
-    size_t row_index;
-    size_t prev_tv_index;
-    size_t tv_index;
-    size_t shifted_tv_index;
+    Index row_index;
+    Index prev_tv_index;
+    Index tv_index;
+    Index shifted_tv_index;
 };
 
+// Sort the rows by row index, returning whether they were already sorted.
+// The rows passed to calculate() very often are already sorted or consist of
+// a few sorted runs (such as the results of an unsorted query, or the previous
+// results of one after a few rows were moved by move_last_over()), so check
+// for that and merge the runs rather than doing a full sort.
+template<typename Index>
+bool sort_by_row_index(std::vector<RowInfo<Index>>& rows)
+{
+    auto less = [](auto const& lft, auto const& rgt) { return lft.row_index < rgt.row_index; };
+
+    // Merging the runs is O(N * runs), so past a few of them a sort is faster
+    const size_t max_runs = 8;
+    size_t run_starts[max_runs];
+    size_t run_count = 1;
+    run_starts[0] = 0;
+    for (size_t i = 1; i < rows.size(); ++i) {
+        if (rows[i].row_index >= rows[i - 1].row_index)
+            continue;
+        if (run_count == max_runs) {
+            std::sort(begin(rows), end(rows), less);
+            return false;
+        }
+        run_starts[run_count++] = i;
+    }
+    if (run_count == 1)
+        return true;
+
+    for (size_t i = 1; i < run_count; ++i) {
+        auto run_end = i + 1 < run_count ? begin(rows) + run_starts[i + 1] : end(rows);
+        std::inplace_merge(begin(rows), begin(rows) + run_starts[i], run_end, less);
+    }
+    return false;
+}
+
 // Calculates the insertions/deletions required for a query on a table without
 // a sort, where `removed` includes the rows which were modified to no longer
 // match the query (but not outright deleted rows, which are filtered out long
@@ -521,7 +577,8 @@ struct RowInfo {
 // However, this function has asymptotically better worst-case performance and
 // extremely cheap best-case performance, and is guaranteed to produce a minimal
 // diff when the only row moves are due to move_last_over().
-void calculate_moves_unsorted(std::vector<RowInfo>& new_rows, IndexSet& removed,
+template<typename Index>
+void calculate_moves_unsorted(std::vector<RowInfo<Index>>& new_rows, IndexSet& removed,
                               IndexSet const& move_candidates,
                               CollectionChangeSet& changeset)
 {
@@ -563,12 +620,13 @@ void calculate_moves_unsorted(std::vector<RowInfo>& new_rows, IndexSet& removed,
     }
 }
 
+template<typename Index>
 class LongestCommonSubsequenceCalculator {
 public:
     // A pair of an index in the table and an index in the table view
     struct Row {
-        size_t row_index;
-        size_t tv_index;
+        Index row_index;
+        Index tv_index;
     };
 
     struct Match {
@@ -585,10 +643,21 @@ public:
 
     LongestCommonSubsequenceCalculator(std::vector<Row>& a, std::vector<Row>& b,
                                        size_t start_index,
-                                       IndexSet const& modifications)
+                                       IndexSet const& modifications,
+                                       std::function<bool ()> const& should_cancel)
     : m_modified(modifications)
+    , m_should_cancel(should_cancel)
     , a(a), b(b)
     {
+        // Look up where each row of `a` appears in `b` up front rather than
+        // doing so every time the row is visited while searching for matches
+        m_b_first.reserve(a.size());
+        for (auto& row : a) {
+            auto it = lower_bound(begin(b), end(b), row.row_index,
+                                  [](auto lft, auto rgt) { return lft.row_index < rgt; });
+            m_b_first.push_back(static_cast<Index>(it - begin(b)));
+        }
+
         find_longest_matches(start_index, a.size(),
                              start_index, b.size());
         m_longest_matches.push_back({a.size(), b.size(), 0});
@@ -596,11 +665,23 @@ public:
 
 private:
     IndexSet const& m_modified;
+    std::function<bool ()> const& m_should_cancel;
 
     // The two arrays of rows being diffed
     // a is sorted by tv_index, b is sorted by row_index
     std::vector<Row> &a, &b;
 
+    // The index in `b` of the first entry with the same row index as each
+    // entry in `a`
+    std::vector<Index> m_b_first;
+
+    struct Length {
+        size_t j, len;
+    };
+    // Scratch space for find_longest_match(), kept around between calls to
+    // avoid reallocating it for each block
+    std::vector<Length> m_prev, m_cur;
+
     // Find the longest matching range in (a + begin1, a + end1) and (b + begin2, b + end2)
     // "Matching" is defined as "has the same row index"; the TV index is just
     // there to let us turn an index in a/b into an index which can be reported
@@ -612,13 +693,12 @@ private:
     // TVs will be 1).
     Match find_longest_match(size_t begin1, size_t end1, size_t begin2, size_t end2)
     {
-        struct Length {
-            size_t j, len;
-        };
         // The length of the matching block for each `j` for the previously checked row
-        std::vector<Length> prev;
+        auto& prev = m_prev;
         // The length of the matching block for each `j` for the row currently being checked
-        std::vector<Length> cur;
+        auto& cur = m_cur;
+        prev.clear();
+        cur.clear();
 
         // Calculate the length of the matching block *ending* at b[j], which
         // is 1 if b[j - 1] did not match, and b[j - 1] + 1 otherwise.
@@ -634,11 +714,10 @@ private:
         // within the range begin2 <= j < end2
         auto for_each_b_match = [&](size_t i, auto&& f) {
             size_t ai = a[i].row_index;
-            // Find the TV indicies at which this row appears in the new results
-            // There should always be at least one (or it would have been
-            // filtered out earlier), but there can be multiple if there are dupes
-            auto it = lower_bound(begin(b), end(b), ai,
-                                  [](auto lft, auto rgt) { return lft.row_index < rgt; });
+            // There should always be at least one entry in `b` for the row (or
+            // it would have been filtered out earlier), but there can be
+            // multiple if there are dupes
+            auto it = begin(b) + m_b_first[i];
             REALM_ASSERT(it != end(b) && it->row_index == ai);
             for (; it != end(b) && it->row_index == ai; ++it) {
                 size_t j = it->tv_index;
@@ -682,30 +761,55 @@ private:
         return best;
     }
 
+    // Find the longest match in the full range, and then repeat for the
+    // unmatched ranges before and after it until there's nothing left which
+    // matches. The ranges still to be searched are kept on an explicit stack
+    // rather than recursing, as the number of ranges can be O(N) in the worst
+    // case and the notifier threads may have small stacks.
     void find_longest_matches(size_t begin1, size_t end1, size_t begin2, size_t end2)
     {
-        // FIXME: recursion could get too deep here
-        // recursion depth worst case is currently O(N) and each recursion uses 320 bytes of stack
-        // could reduce worst case to O(sqrt(N)) (and typical case to O(log N))
-        // biasing equal selections towards the middle, but that's still
-        // insufficient for Android's 8 KB stacks
-        auto m = find_longest_match(begin1, end1, begin2, end2);
-        if (!m.size)
-            return;
-        if (m.i > begin1 && m.j > begin2)
-            find_longest_matches(begin1, m.i, begin2, m.j);
-        m_longest_matches.push_back(m);
-        if (m.i + m.size < end2 && m.j + m.size < end2)
-            find_longest_matches(m.i + m.size, end1, m.j + m.size, end2);
+        struct Range {
+            size_t begin1, end1, begin2, end2;
+        };
+        std::vector<Range> pending;
+        pending.push_back({begin1, end1, begin2, end2});
+        // Checking for cancellation takes a lock, so only do it every so often
+        size_t iterations = 0;
+        while (!pending.empty()) {
+            if (m_should_cancel && iterations++ % 1024 == 0 && m_should_cancel())
+                return;
+
+            auto r = pending.back();
+            pending.pop_back();
+
+            auto m = find_longest_match(r.begin1, r.end1, r.begin2, r.end2);
+            if (!m.size)
+                continue;
+            m_longest_matches.push_back(m);
+            if (m.i > r.begin1 && m.j > r.begin2)
+                pending.push_back({r.begin1, m.i, r.begin2, m.j});
+            if (m.i + m.size < r.end1 && m.j + m.size < r.end2)
+                pending.push_back({m.i + m.size, r.end1, m.j + m.size, r.end2});
+        }
+
+        // The matches found in disjoint ranges are themselves disjoint and
+        // increasing in both `i` and `j`, so this puts them in the order in
+        // which they appear in both sequences
+        std::sort(begin(m_longest_matches), end(m_longest_matches),
+                  [](auto const& lft, auto const& rgt) { return lft.i < rgt.i; });
     }
 };
 
-void calculate_moves_sorted(std::vector<RowInfo>& rows, CollectionChangeSet& changeset)
+// Returns false without doing anything if more than `max_rows` rows would
+// need to be searched
+template<typename Index>
+bool calculate_moves_sorted(std::vector<RowInfo<Index>>& rows, CollectionChangeSet& changeset,
+                            std::function<bool ()> const& should_cancel, size_t max_rows)
 {
     // The RowInfo array contains information about the old and new TV indices of
     // each row, which we need to turn into two sequences of rows, which we'll
     // then find matches in
-    std::vector<LongestCommonSubsequenceCalculator::Row> a, b;
+    std::vector<typename LongestCommonSubsequenceCalculator<Index>::Row> a, b;
 
     a.reserve(rows.size());
     for (auto& row : rows) {
@@ -725,19 +829,24 @@ void calculate_moves_sorted(std::vector<RowInfo>& rows, CollectionChangeSet& cha
         }
     }
     if (first_difference == IndexSet::npos)
-        return;
+        return true;
+    if (rows.size() - first_difference > max_rows)
+        return false;
 
     // Note that `b` is sorted by row_index, while `a` is sorted by tv_index
     b.reserve(rows.size());
     for (size_t i = 0; i < rows.size(); ++i)
-        b.push_back({rows[i].row_index, i});
+        b.push_back({rows[i].row_index, static_cast<Index>(i)});
     std::sort(begin(b), end(b), [](auto lft, auto rgt) {
         return std::tie(lft.row_index, lft.tv_index) < std::tie(rgt.row_index, rgt.tv_index);
     });
 
     // Calculate the LCS of the two sequences
-    auto matches = LongestCommonSubsequenceCalculator(a, b, first_difference,
-                                                      changeset.modifications).m_longest_matches;
+    auto matches = LongestCommonSubsequenceCalculator<Index>(a, b, first_difference,
+                                                             changeset.modifications,
+                                                             should_cancel).m_longest_matches;
+    if (should_cancel && should_cancel())
+        return true;
 
     // And then insert and delete rows as needed to align them
     size_t i = first_difference, j = first_difference;
@@ -749,21 +858,30 @@ void calculate_moves_sorted(std::vector<RowInfo>& rows, CollectionChangeSet& cha
         i += match.size;
         j += match.size;
     }
+    return true;
 }
 
-} // Anonymous namespace
-
-CollectionChangeBuilder CollectionChangeBuilder::calculate(std::vector<size_t> const& prev_rows,
-                                                           std::vector<size_t> const& next_rows,
-                                                           std::function<bool (size_t)> row_did_change,
-                                                           util::Optional<IndexSet> const& move_candidates)
+// Calculate the changes for CollectionChangeBuilder::calculate() into `ret`
+// using `Index` for the row and table view indices, which must be able to
+// represent all of them. Returns false if the calculation was cancelled or
+// gave up, in which case `ret` is already the final result.
+template<typename Index>
+bool calculate_changes(CollectionChangeBuilder& ret,
+                       std::vector<size_t> const& prev_rows,
+                       std::vector<size_t> const& next_rows,
+                       std::function<bool (size_t)> const& row_did_change,
+                       util::Optional<IndexSet> const& move_candidates,
+                       std::function<bool ()> const& should_cancel,
+                       size_t max_diff_rows)
 {
-    REALM_ASSERT_DEBUG(!move_candidates || std::is_sorted(begin(next_rows), end(next_rows)));
-
-    CollectionChangeBuilder ret;
+    // Checking for cancellation is cheap but not free, so it's only done
+    // between the major steps and every so often within the long loops
+    auto cancelled = [&](size_t i = 0) {
+        return should_cancel && i % 1024 == 0 && should_cancel();
+    };
 
     size_t deleted = 0;
-    std::vector<RowInfo> old_rows;
+    std::vector<RowInfo<Index>> old_rows;
     old_rows.reserve(prev_rows.size());
     for (size_t i = 0; i < prev_rows.size(); ++i) {
         if (prev_rows[i] == IndexSet::npos) {
@@ -771,20 +889,19 @@ CollectionChangeBuilder CollectionChangeBuilder::calculate(std::vector<size_t> c
             ret.deletions.add(i);
         }
         else
-            old_rows.push_back({prev_rows[i], IndexSet::npos, i, i - deleted});
+            old_rows.push_back({static_cast<Index>(prev_rows[i]), npos<Index>,
+                                static_cast<Index>(i), static_cast<Index>(i - deleted)});
     }
-    std::sort(begin(old_rows), end(old_rows), [](auto& lft, auto& rgt) {
-        return lft.row_index < rgt.row_index;
-    });
+    sort_by_row_index(old_rows);
 
-    std::vector<RowInfo> new_rows;
+    std::vector<RowInfo<Index>> new_rows;
     new_rows.reserve(next_rows.size());
     for (size_t i = 0; i < next_rows.size(); ++i) {
-        new_rows.push_back({next_rows[i], IndexSet::npos, i, 0});
+        new_rows.push_back({static_cast<Index>(next_rows[i]), npos<Index>, static_cast<Index>(i), 0});
     }
-    std::sort(begin(new_rows), end(new_rows), [](auto& lft, auto& rgt) {
-        return lft.row_index < rgt.row_index;
-    });
+    bool new_rows_were_sorted = sort_by_row_index(new_rows);
+    if (cancelled())
+        return false;
 
     // Don't add rows which were modified to not match the query to `deletions`
     // immediately because the unsorted move logic needs to be able to
@@ -822,14 +939,20 @@ CollectionChangeBuilder CollectionChangeBuilder::calculate(std::vector<size_t> c
     // Filter out the new insertions since we don't need them for any of the
     // further calculations
     new_rows.erase(std::remove_if(begin(new_rows), end(new_rows),
-                                  [](auto& row) { return row.prev_tv_index == IndexSet::npos; }),
+                                  [](auto& row) { return row.prev_tv_index == npos<Index>; }),
                    end(new_rows));
-    std::sort(begin(new_rows), end(new_rows),
-              [](auto& lft, auto& rgt) { return lft.tv_index < rgt.tv_index; });
+    // If the rows were already in row index order then they're still in TV
+    // index order as well
+    if (!new_rows_were_sorted) {
+        std::sort(begin(new_rows), end(new_rows),
+                  [](auto& lft, auto& rgt) { return lft.tv_index < rgt.tv_index; });
+    }
 
-    for (auto& row : new_rows) {
-        if (row_did_change(row.row_index)) {
-            ret.modifications.add(row.tv_index);
+    for (size_t k = 0; k < new_rows.size(); ++k) {
+        if (cancelled(k + 1))
+            return false;
+        if (row_did_change(new_rows[k].row_index)) {
+            ret.modifications.add(new_rows[k].tv_index);
         }
     }
 
@@ -837,9 +960,52 @@ CollectionChangeBuilder CollectionChangeBuilder::calculate(std::vector<size_t> c
         calculate_moves_unsorted(new_rows, removed, *move_candidates, ret);
     }
     else {
-        calculate_moves_sorted(new_rows, ret);
+        if (!calculate_moves_sorted(new_rows, ret, should_cancel, max_diff_rows)) {
+            // Report the whole collection as replaced rather than spending
+            // longer on the diff than re-reading everything would take
+            ret = {};
+            ret.deletions.set(prev_rows.size());
+            ret.insertions.set(next_rows.size());
+            return false;
+        }
+        if (cancelled())
+            return false;
     }
     ret.deletions.add(removed);
+    return true;
+}
+
+} // Anonymous namespace
+
+CollectionChangeBuilder CollectionChangeBuilder::calculate(std::vector<size_t> const& prev_rows,
+                                                           std::vector<size_t> const& next_rows,
+                                                           std::function<bool (size_t)> row_did_change,
+                                                           util::Optional<IndexSet> const& move_candidates,
+                                                           std::function<bool ()> const& should_cancel,
+                                                           size_t max_diff_rows)
+{
+    REALM_ASSERT_DEBUG(!move_candidates || std::is_sorted(begin(next_rows), end(next_rows)));
+
+    // Use 32-bit indices for the intermediate arrays if every row index and
+    // both collection sizes fit in them
+    auto fits_in_32_bits = [](std::vector<size_t> const& rows) {
+        const size_t max = std::numeric_limits<uint32_t>::max();
+        return rows.size() < max && std::all_of(begin(rows), end(rows), [=](size_t row) {
+            return row < max || row == IndexSet::npos;
+        });
+    };
+
+    CollectionChangeBuilder ret;
+    bool complete;
+    if (fits_in_32_bits(prev_rows) && fits_in_32_bits(next_rows))
+        complete = calculate_changes<uint32_t>(ret, prev_rows, next_rows, row_did_change,
+                                               move_candidates, should_cancel, max_diff_rows);
+    else
+        complete = calculate_changes<size_t>(ret, prev_rows, next_rows, row_did_change,
+                                             move_candidates, should_cancel, max_diff_rows);
+    if (!complete)
+        return ret;
+
     ret.verify();
 
 #ifdef REALM_DEBUG
@@ -848,7 +1014,8 @@ CollectionChangeBuilder CollectionChangeBuilder::calculate(std::vector<size_t> c
         auto it = util::make_reverse_iterator(ret.deletions.end());
         auto end = util::make_reverse_iterator(ret.deletions.begin());
         for (; it != end; ++it) {
-            rows.erase(rows.begin() + it->first, rows.begin() + it->second);
+            auto range = *it;
+            rows.erase(rows.begin() + range.first, rows.begin() + range.second);
         }
 
         for (auto i : ret.insertions.as_indexes()) {
@@ -883,3 +1050,15 @@ CollectionChangeSet CollectionChangeBuilder::finalize() &&
         std::move(columns)
     };
 }
+
+CollectionChangeSet CollectionChangeBuilder::finalize_lazily() &&
+{
+    return {
+        std::move(deletions),
+        std::move(insertions),
+        {},
+        std::move(modifications),
+        std::move(moves),
+        std::move(columns)
+    };
+}
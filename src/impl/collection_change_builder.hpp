@@ -20,11 +20,10 @@
 #define REALM_COLLECTION_CHANGE_BUILDER_HPP
 
 #include "collection_notifications.hpp"
+#include "util/flat_index_map.hpp"
 
 #include <realm/util/optional.hpp>
 
-#include <unordered_map>
-
 namespace realm {
 namespace _impl {
 class CollectionChangeBuilder : public CollectionChangeSet {
@@ -44,13 +43,24 @@ public:
     // If `move_candidates` is supplied they it will be used to do more accurate
     // determination of which rows moved. This is only supported when the rows
     // are in table order (i.e. not sorted or from a LinkList)
+    // `should_cancel` is polled periodically, and if it returns true the
+    // calculation is abandoned and a meaningless changeset is returned. It
+    // should keep returning true once it has done so to let the caller tell.
+    // If finding the moved rows would require searching more than
+    // `max_diff_rows` rows, every row is instead reported as deleted and
+    // then reinserted.
     static CollectionChangeBuilder calculate(std::vector<size_t> const& old_rows,
                                              std::vector<size_t> const& new_rows,
                                              std::function<bool (size_t)> row_did_change,
-                                             util::Optional<IndexSet> const& move_candidates = util::none);
+                                             util::Optional<IndexSet> const& move_candidates = util::none,
+                                             std::function<bool ()> const& should_cancel = nullptr,
+                                             size_t max_diff_rows = -1);
 
     // generic operations {
     CollectionChangeSet finalize() &&;
+    // Produce a changeset for a CollectionChangeView constructed with `lazy`
+    // set, which skips calculating the modified indices in the old collection
+    CollectionChangeSet finalize_lazily() &&;
     void merge(CollectionChangeBuilder&&);
 
     void insert(size_t ndx, size_t count=1, bool track_moves=true);
@@ -77,8 +87,14 @@ public:
     void insert_column(size_t ndx);
     void move_column(size_t from, size_t to);
 
+    // Set whether modify() records which columns were modified in `columns`
+    // in addition to which rows were. This is on by default, but costs an
+    // extra IndexSet update per modification which most users don't need.
+    // Must be set before any modifications are made.
+    void set_track_columns(bool track_columns) noexcept { m_track_columns = track_columns; }
+
 private:
-    std::unordered_map<size_t, size_t> m_move_mapping;
+    util::FlatIndexMap m_move_mapping;
     bool m_track_columns = true;
 
     template<typename Func>
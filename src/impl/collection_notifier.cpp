@@ -19,30 +19,67 @@
 #include "impl/collection_notifier.hpp"
 
 #include "impl/realm_coordinator.hpp"
+#include "object.hpp"
+#include "object_store.hpp"
 #include "shared_realm.hpp"
 
 #include <realm/group_shared.hpp>
 #include <realm/link_view.hpp>
 
+#include <algorithm>
+
 using namespace realm;
 using namespace realm::_impl;
 
 std::function<bool (size_t)>
-CollectionNotifier::get_modification_checker(TransactionChangeInfo const& info,
+CollectionNotifier::get_modification_checker(TransactionChangeInfo& info,
                                              Table const& root_table)
 {
     // First check if any of the tables accessible from the root table were
     // actually modified. This can be false if there were only insertions, or
     // deletions which were not linked to by any row in the linking table
-    auto table_modified = [&](auto& tbl) {
-        return tbl.table_ndx < info.tables.size()
-            && !info.tables[tbl.table_ndx].modifications.empty();
-    };
-    if (!any_of(begin(m_related_tables), end(m_related_tables), table_modified)) {
+    if (!observed_table_modified(info)) {
         return [](size_t) { return false; };
     }
 
-    return DeepChangeChecker(info, root_table, m_related_tables);
+    REALM_ASSERT(m_sg);
+    DeepChangeChecker::ensure_modified_via_links(info, SharedGroupFriend::get_group(*m_sg));
+    return DeepChangeChecker(info, root_table, m_observed_tables);
+}
+
+IndexSet CollectionNotifier::get_modified_rows(TransactionChangeInfo& info,
+                                               Table const& root_table,
+                                               std::vector<size_t> rows)
+{
+    if (!observed_table_modified(info))
+        return {};
+    REALM_ASSERT(m_sg);
+    DeepChangeChecker::ensure_modified_via_links(info, SharedGroupFriend::get_group(*m_sg));
+    return DeepChangeChecker(info, root_table, m_observed_tables).modified_rows(std::move(rows));
+}
+
+bool CollectionNotifier::related_table_modified(TransactionChangeInfo const& info,
+                                                size_t ignored_table_ndx) const
+{
+    return any_of(begin(m_related_tables), end(m_related_tables), [&](auto& tbl) {
+        return tbl.table_ndx != ignored_table_ndx
+            && tbl.table_ndx < info.tables.size()
+            && !info.tables[tbl.table_ndx].modifications.empty();
+    });
+}
+
+bool CollectionNotifier::observed_table_modified(TransactionChangeInfo const& info) const
+{
+    return any_of(begin(m_observed_tables), end(m_observed_tables), [&](auto& tbl) {
+        if (tbl.table_ndx >= info.tables.size())
+            return false;
+        auto& changes = info.tables[tbl.table_ndx];
+        if (tbl.columns.empty())
+            return !changes.modifications.empty();
+        return any_of(begin(tbl.columns), end(tbl.columns), [&](size_t col) {
+            return col < changes.columns.size() && !changes.columns[col].empty();
+        });
+    });
 }
 
 void DeepChangeChecker::find_related_tables(std::vector<RelatedTable>& out, Table const& table)
@@ -67,17 +104,195 @@ void DeepChangeChecker::find_related_tables(std::vector<RelatedTable>& out, Tabl
     }
 }
 
+void DeepChangeChecker::find_related_tables(std::vector<RelatedTable>& out, Table const& table,
+                                            std::vector<std::string> const& key_paths)
+{
+    if (key_paths.empty()) {
+        find_related_tables(out, table);
+        return;
+    }
+
+    auto related_table = [&](size_t table_ndx) -> RelatedTable& {
+        auto it = find_if(begin(out), end(out), [=](auto& tbl) { return tbl.table_ndx == table_ndx; });
+        if (it != out.end())
+            return *it;
+        out.push_back({table_ndx, {}, {}});
+        return out.back();
+    };
+    auto add_unique = [](auto& vec, auto const& value) {
+        if (find(begin(vec), end(vec), value) == vec.end())
+            vec.push_back(value);
+    };
+
+    // The root table has to be first, as with the other overload
+    related_table(table.get_index_in_group());
+    for (auto& key_path : key_paths) {
+        Table const* current = &table;
+        for (size_t pos = 0; ; ) {
+            size_t end = key_path.find('.', pos);
+            auto name = key_path.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+            size_t col = current->get_column_index(name);
+            bool is_last = end == std::string::npos;
+            auto type = col == npos ? type_Int : current->get_column_type(col);
+            if (col == npos || (!is_last && type != type_Link && type != type_LinkList)) {
+                auto object_type = ObjectStore::object_type_for_table_name(current->get_name());
+                throw InvalidPropertyException(std::string(object_type), name);
+            }
+
+            add_unique(related_table(current->get_index_in_group()).columns, col);
+            if (is_last)
+                break;
+
+            add_unique(related_table(current->get_index_in_group()).links, OutgoingLink{col, type == type_LinkList});
+            current = current->get_link_target(col).get();
+            pos = end + 1;
+        }
+    }
+}
+
+void DeepChangeChecker::merge_related_tables(std::vector<RelatedTable>& out, std::vector<RelatedTable> const& tables)
+{
+    for (auto& table : tables) {
+        auto it = find_if(begin(out), end(out), [&](auto& tbl) { return tbl.table_ndx == table.table_ndx; });
+        if (it == out.end()) {
+            out.push_back(table);
+            continue;
+        }
+        for (auto& link : table.links) {
+            if (find(begin(it->links), end(it->links), link) == it->links.end())
+                it->links.push_back(link);
+        }
+        if (it->columns.empty() || table.columns.empty()) {
+            it->columns.clear();
+            continue;
+        }
+        for (auto col : table.columns) {
+            if (find(begin(it->columns), end(it->columns), col) == it->columns.end())
+                it->columns.push_back(col);
+        }
+    }
+}
+
+void DeepChangeChecker::calculate_modified_via_links(TransactionChangeInfo& info, Group const& group)
+{
+    info.modified_via_links.clear();
+    info.modified_via_links_calculated = true;
+
+    auto is_observed = [&](size_t table_ndx) {
+        return info.track_all || (table_ndx < info.table_modifications_needed.size()
+                                  && info.table_modifications_needed[table_ndx]);
+    };
+
+    // Only links from tables which something is observing can be part of a
+    // path from an observed row to a modified row
+    struct IncomingLink {
+        ConstTableRef origin;
+        size_t col_ndx;
+    };
+    std::vector<std::vector<IncomingLink>> incoming(group.size());
+    std::vector<ConstTableRef> tables(group.size());
+    bool has_links = false;
+    for (size_t i = 0; i < group.size(); ++i) {
+        tables[i] = group.get_table(i);
+        if (!is_observed(i))
+            continue;
+        for (size_t col = 0, count = tables[i]->get_column_count(); col != count; ++col) {
+            auto type = tables[i]->get_column_type(col);
+            if (type == type_Link || type == type_LinkList) {
+                incoming[tables[i]->get_link_target(col)->get_index_in_group()].push_back({tables[i], col});
+                has_links = true;
+            }
+        }
+    }
+    if (!has_links)
+        return;
+
+    // Walk backwards from the modified rows one link at a time, stopping at
+    // the same depth as check_row() would so that the results match
+    struct Entry {
+        size_t table_ndx;
+        size_t row_ndx;
+    };
+    std::vector<Entry> current, next;
+    for (size_t i = 0; i < info.tables.size() && i < incoming.size(); ++i) {
+        if (incoming[i].empty())
+            continue;
+        for (auto row : info.tables[i].modifications.as_indexes())
+            current.push_back({i, row});
+    }
+
+    std::vector<util::FlatIndexMap> reached(group.size());
+    for (size_t depth = 1; depth < max_depth && !current.empty(); ++depth) {
+        for (auto const& entry : current) {
+            auto& target = tables[entry.table_ndx];
+            for (auto const& link : incoming[entry.table_ndx]) {
+                size_t origin_ndx = link.origin->get_index_in_group();
+                auto& origin_reached = reached[origin_ndx];
+                for (size_t i = 0, count = target->get_backlink_count(entry.row_ndx, *link.origin, link.col_ndx); i < count; ++i) {
+                    size_t row = target->get_backlink(entry.row_ndx, *link.origin, link.col_ndx, i);
+                    if (origin_reached.count(row))
+                        continue;
+                    origin_reached[row] = depth;
+                    if (!incoming[origin_ndx].empty())
+                        next.push_back({origin_ndx, row});
+                }
+            }
+        }
+        current.swap(next);
+        next.clear();
+    }
+
+    info.modified_via_links.resize(group.size());
+    std::vector<size_t> rows;
+    for (size_t i = 0; i < reached.size(); ++i) {
+        if (reached[i].empty())
+            continue;
+        rows.clear();
+        for (auto const& entry : reached[i])
+            rows.push_back(entry.first);
+        std::sort(rows.begin(), rows.end());
+        for (auto row : rows)
+            info.modified_via_links[i].add(row);
+    }
+}
+
+void DeepChangeChecker::ensure_modified_via_links(TransactionChangeInfo& info, Group const& group)
+{
+    if (!info.modified_via_links_mutex)
+        return;
+    std::lock_guard<std::mutex> lock(*info.modified_via_links_mutex);
+    if (!info.modified_via_links_calculated)
+        calculate_modified_via_links(info, group);
+}
+
 DeepChangeChecker::DeepChangeChecker(TransactionChangeInfo const& info,
                                      Table const& root_table,
                                      std::vector<RelatedTable> const& related_tables)
 : m_info(info)
 , m_root_table(root_table)
 , m_root_table_ndx(root_table.get_index_in_group())
-, m_root_modifications(m_root_table_ndx < info.tables.size() ? &info.tables[m_root_table_ndx].modifications : nullptr)
 , m_related_tables(related_tables)
+, m_filtered(any_of(begin(related_tables), end(related_tables), [](auto& tbl) { return !tbl.columns.empty(); }))
 {
 }
 
+bool DeepChangeChecker::row_modified(size_t table_ndx, size_t row_ndx) const
+{
+    if (table_ndx >= m_info.tables.size())
+        return false;
+    auto& changes = m_info.tables[table_ndx];
+    if (!m_filtered)
+        return changes.modifications.contains(row_ndx);
+
+    auto it = find_if(begin(m_related_tables), end(m_related_tables),
+                      [&](auto&& tbl) { return tbl.table_ndx == table_ndx; });
+    if (it == m_related_tables.end() || it->columns.empty())
+        return changes.modifications.contains(row_ndx);
+    return any_of(begin(it->columns), end(it->columns), [&](size_t col) {
+        return col < changes.columns.size() && changes.columns[col].contains(row_ndx);
+    });
+}
+
 bool DeepChangeChecker::check_outgoing_links(size_t table_ndx,
                                              Table const& table,
                                              size_t row_ndx, size_t depth)
@@ -137,27 +352,63 @@ bool DeepChangeChecker::check_row(Table const& table, size_t idx, size_t depth)
     }
 
     size_t table_ndx = table.get_index_in_group();
-    if (depth > 0 && table_ndx < m_info.tables.size() && m_info.tables[table_ndx].modifications.contains(idx))
+    if (depth > 0 && row_modified(table_ndx, idx)) {
+        m_found_depth = depth;
         return true;
+    }
 
-    if (m_not_modified.size() <= table_ndx)
+    if (m_not_modified.size() <= table_ndx) {
         m_not_modified.resize(table_ndx + 1);
+        m_modified.resize(table_ndx + 1);
+    }
     if (m_not_modified[table_ndx].contains(idx))
         return false;
 
+    // A modification previously found from this row is only reachable from
+    // here if it's within the depth limit from the current position
+    auto& modified = m_modified[table_ndx];
+    auto it = modified.find(idx);
+    if (it != modified.end() && depth + it->second < m_current_path.size()) {
+        m_found_depth = depth + it->second;
+        return true;
+    }
+
     bool ret = check_outgoing_links(table_ndx, table, idx, depth);
-    if (!ret && (depth == 0 || !m_current_path[depth - 1].depth_exceeded))
+    if (ret) {
+        size_t distance = m_found_depth - depth;
+        auto& existing = modified[idx];
+        if (existing == 0 || distance < existing)
+            existing = distance;
+    }
+    else if (depth == 0 || !m_current_path[depth - 1].depth_exceeded)
         m_not_modified[table_ndx].add(idx);
     return ret;
 }
 
 bool DeepChangeChecker::operator()(size_t ndx)
 {
-    if (m_root_modifications && m_root_modifications->contains(ndx))
+    if (row_modified(m_root_table_ndx, ndx))
         return true;
+    if (m_info.modified_via_links_calculated && !m_filtered) {
+        return m_root_table_ndx < m_info.modified_via_links.size()
+            && m_info.modified_via_links[m_root_table_ndx].contains(ndx);
+    }
     return check_row(m_root_table, ndx, 0);
 }
 
+IndexSet DeepChangeChecker::modified_rows(std::vector<size_t> rows)
+{
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    IndexSet ret;
+    for (auto row : rows) {
+        if ((*this)(row))
+            ret.add(row);
+    }
+    return ret;
+}
+
 CollectionNotifier::CollectionNotifier(std::shared_ptr<Realm> realm)
 : m_realm(std::move(realm))
 , m_sg_version(Realm::Internal::get_shared_group(*m_realm)->get_version_of_current_transaction())
@@ -171,7 +422,8 @@ CollectionNotifier::~CollectionNotifier()
     unregister();
 }
 
-size_t CollectionNotifier::add_callback(CollectionChangeCallback callback)
+size_t CollectionNotifier::add_callback(CollectionChangeCallback callback, NotificationPriority priority,
+                                        std::vector<DeepChangeChecker::RelatedTable> observed_tables)
 {
     m_realm->verify_thread();
 
@@ -185,13 +437,24 @@ size_t CollectionNotifier::add_callback(CollectionChangeCallback callback)
         return token;
     };
 
-    std::lock_guard<std::mutex> lock(m_callback_mutex);
-    auto token = next_token();
-    m_callbacks.push_back({std::move(callback), {}, {}, token, false, false});
-    if (m_callback_index == npos) { // Don't need to wake up if we're already sending notifications
-        Realm::Internal::get_coordinator(*m_realm).wake_up_notifier_worker();
-        m_have_callbacks = true;
+    size_t token;
+    bool wake_up = false;
+    {
+        std::lock_guard<std::mutex> lock(m_callback_mutex);
+        token = next_token();
+        m_callbacks.push_back({std::move(callback), {}, false, token, m_change_count, uint64_t(-1), false, priority,
+                               std::move(observed_tables)});
+        update_priority();
+        m_observed_tables_changed = true;
+        if (m_callback_index == npos) { // Don't need to wake up if we're already sending notifications
+            wake_up = true;
+            m_have_callbacks = true;
+        }
     }
+    // Waking up the notifier acquires the coordinator's notifier mutex, which
+    // is held while acquiring m_callback_mutex elsewhere
+    if (wake_up)
+        Realm::Internal::get_coordinator(*m_realm).wake_up_notifier_worker();
     return token;
 }
 
@@ -216,9 +479,42 @@ void CollectionNotifier::remove_callback(size_t token)
         m_callbacks.erase(it);
 
         m_have_callbacks = !m_callbacks.empty();
+        update_priority();
+        m_observed_tables_changed = true;
     }
 }
 
+void CollectionNotifier::update_observed_tables()
+{
+    m_observed_tables_changed = false;
+
+    // Everything is observed if any callback didn't ask for specific key
+    // paths, or if there's no callbacks and so nothing is reported anyway
+    bool observe_all = m_callbacks.empty() || any_of(begin(m_callbacks), end(m_callbacks), [](auto& callback) {
+        return callback.observed_tables.empty();
+    });
+    if (observe_all) {
+        m_observed_tables = m_related_tables;
+        return;
+    }
+
+    m_observed_tables.clear();
+    for (auto& callback : m_callbacks)
+        DeepChangeChecker::merge_related_tables(m_observed_tables, callback.observed_tables);
+}
+
+void CollectionNotifier::update_priority()
+{
+    if (m_callbacks.empty()) {
+        m_priority = NotificationPriority::Interactive;
+        return;
+    }
+    auto priority = NotificationPriority::Bulk;
+    for (auto& callback : m_callbacks)
+        priority = std::min(priority, callback.priority);
+    m_priority = priority;
+}
+
 void CollectionNotifier::suppress_next_notification(size_t token)
 {
     {
@@ -231,7 +527,7 @@ void CollectionNotifier::suppress_next_notification(size_t token)
     std::lock_guard<std::mutex> lock(m_callback_mutex);
     auto it = find_callback(token);
     if (it != end(m_callbacks)) {
-        it->skip_next = true;
+        it->skipped_change = m_change_count;
     }
 }
 
@@ -267,22 +563,78 @@ void CollectionNotifier::set_table(Table const& table)
 {
     m_related_tables.clear();
     DeepChangeChecker::find_related_tables(m_related_tables, table);
+    m_observed_tables = m_related_tables;
 }
 
 void CollectionNotifier::add_required_change_info(TransactionChangeInfo& info)
 {
+    {
+        std::lock_guard<std::mutex> lock(m_callback_mutex);
+        if (m_observed_tables_changed)
+            update_observed_tables();
+    }
+
     if (!do_add_required_change_info(info) || m_related_tables.empty()) {
         return;
     }
 
-    auto max = max_element(begin(m_related_tables), end(m_related_tables),
+    auto& tables = needs_all_related_tables() ? m_related_tables : m_observed_tables;
+    auto max = max_element(begin(tables), end(tables),
                            [](auto&& a, auto&& b) { return a.table_ndx < b.table_ndx; });
 
     if (max->table_ndx >= info.table_modifications_needed.size())
         info.table_modifications_needed.resize(max->table_ndx + 1, false);
-    for (auto& tbl : m_related_tables) {
+    for (auto& tbl : tables) {
         info.table_modifications_needed[tbl.table_ndx] = true;
     }
+
+    // Checking for modifications to specific key paths needs to know which
+    // columns were modified
+    for (auto& tbl : m_observed_tables) {
+        if (tbl.columns.empty())
+            continue;
+        if (tbl.table_ndx >= info.table_columns_needed.size())
+            info.table_columns_needed.resize(tbl.table_ndx + 1, false);
+        info.table_columns_needed[tbl.table_ndx] = true;
+    }
+}
+
+void CollectionNotifier::run_all(std::vector<std::shared_ptr<CollectionNotifier>> const& notifiers,
+                                 std::function<void (CollectionNotifier&)> const& on_ready)
+{
+    // The number of notifiers not yet run for each fingerprint. Handing over
+    // a notifier's results consumes them, so one can't be reported as ready
+    // while there's a later notifier which might want to reuse them.
+    std::unordered_map<std::string, size_t> remaining;
+    for (auto& notifier : notifiers) {
+        if (!notifier->m_fingerprint.empty())
+            ++remaining[notifier->m_fingerprint];
+    }
+
+    // The most recent notifier run for each fingerprint, which is the one
+    // which the later ones can reuse the work from
+    std::unordered_map<std::string, CollectionNotifier*> sources;
+    for (auto& notifier : notifiers) {
+        if (notifier->m_fingerprint.empty()) {
+            notifier->m_last_run_shared = false;
+            notifier->run();
+            on_ready(*notifier);
+            continue;
+        }
+
+        // Notifiers whose callbacks observe different things report
+        // different modifications, so they can't share them
+        auto& source = sources[notifier->m_fingerprint];
+        notifier->m_last_run_shared = source && source->m_observed_tables == notifier->m_observed_tables
+                                   && notifier->run_from(*source);
+        if (!notifier->m_last_run_shared)
+            notifier->run();
+        if (source)
+            on_ready(*source);
+        source = notifier.get();
+        if (--remaining[notifier->m_fingerprint] == 0)
+            on_ready(*notifier);
+    }
 }
 
 void CollectionNotifier::prepare_handover()
@@ -295,40 +647,51 @@ void CollectionNotifier::prepare_handover()
 #ifdef REALM_DEBUG
     std::lock_guard<std::mutex> lock(m_callback_mutex);
     for (auto& callback : m_callbacks)
-        REALM_ASSERT(!callback.skip_next);
+        REALM_ASSERT(callback.skipped_change == uint64_t(-1) || callback.skipped_change < m_change_count);
 #endif
 }
 
 void CollectionNotifier::before_advance()
 {
     for_each_callback([&](auto& lock, auto& callback) {
-        if (callback.changes_to_deliver.empty()) {
+        if (!callback.changes_to_deliver || callback.changes_to_deliver->empty()) {
             return;
         }
 
+        // Only the reference to the shared changeset is copied here
         auto changes = callback.changes_to_deliver;
         // acquire a local reference to the callback so that removing the
         // callback from within it can't result in a dangling pointer
         auto cb = callback.fn;
         lock.unlock();
-        cb.before(changes);
+        cb.before(*changes);
     });
 }
 
 void CollectionNotifier::after_advance()
 {
     for_each_callback([&](auto& lock, auto& callback) {
-        if (callback.initial_delivered && callback.changes_to_deliver.empty()) {
+        bool has_changes = callback.changes_to_deliver && !callback.changes_to_deliver->empty();
+        if (callback.initial_delivered && !has_changes) {
             return;
         }
         callback.initial_delivered = true;
 
         auto changes = std::move(callback.changes_to_deliver);
+        bool lazy = callback.changes_are_lazy;
         // acquire a local reference to the callback so that removing the
         // callback from within it can't result in a dangling pointer
         auto cb = callback.fn;
         lock.unlock();
-        cb.after(changes);
+
+        // Both branches need to be lvalues so that the shared changes aren't
+        // copied for each callback
+        static const CollectionChangeSet no_changes;
+        auto const& to_deliver = changes ? *changes : no_changes;
+        if (cb.wants_view())
+            cb.after(CollectionChangeView(to_deliver, lazy && changes));
+        else
+            cb.after(to_deliver);
     });
 }
 
@@ -345,6 +708,7 @@ void CollectionNotifier::deliver_error(std::exception_ptr error)
     // Remove all the callbacks as we never need to call anything ever again
     // after delivering an error
     m_callbacks.clear();
+    m_pending_changes.clear();
     m_error = true;
 }
 
@@ -359,8 +723,60 @@ bool CollectionNotifier::package_for_delivery()
     if (!prepare_to_deliver())
         return false;
     std::lock_guard<std::mutex> l(m_callback_mutex);
-    for (auto& callback : m_callbacks)
-        callback.changes_to_deliver = std::move(callback.accumulated_changes).finalize();
+
+    // Callbacks only see different changes if they were added or had a
+    // notification suppressed since the last delivery, so there's usually only
+    // one distinct set of changes to build and every callback can share it
+    using Key = std::pair<uint64_t, uint64_t>;
+    auto key_for = [](Callback const& callback) {
+        // A skipped change from before the first change is irrelevant
+        return Key{callback.first_change, callback.skipped_change < callback.first_change
+                                          ? uint64_t(-1) : callback.skipped_change};
+    };
+    struct Built {
+        Key key;
+        std::shared_ptr<CollectionChangeSet const> changes;
+        bool lazy;
+    };
+    std::vector<Built> built;
+    for (auto& callback : m_callbacks) {
+        auto key = key_for(callback);
+        auto it = find_if(begin(built), end(built), [&](auto& b) { return b.key == key; });
+        if (it == built.end())
+            built.push_back({key, nullptr, callback.fn.wants_view()});
+        else
+            it->lazy = it->lazy && callback.fn.wants_view();
+    }
+
+    for (auto& b : built) {
+        // The pending changes can be consumed rather than copied if only one
+        // changeset needs to be built from them
+        bool consume = built.size() == 1;
+        CollectionChangeBuilder changes;
+        for (auto& pending : m_pending_changes) {
+            if (pending.first < b.key.first || pending.first == b.key.second)
+                continue;
+            if (consume)
+                changes.merge(std::move(pending.second));
+            else
+                changes.merge(CollectionChangeBuilder(pending.second));
+        }
+        if (b.lazy)
+            b.changes = std::make_shared<CollectionChangeSet>(std::move(changes).finalize_lazily());
+        else
+            b.changes = std::make_shared<CollectionChangeSet>(std::move(changes).finalize());
+    }
+
+    for (auto& callback : m_callbacks) {
+        auto key = key_for(callback);
+        auto& b = *find_if(begin(built), end(built), [&](auto& b) { return b.key == key; });
+        callback.changes_to_deliver = b.changes;
+        callback.changes_are_lazy = b.lazy;
+        callback.first_change = m_change_count;
+        if (callback.skipped_change < m_change_count)
+            callback.skipped_change = uint64_t(-1);
+    }
+    m_pending_changes.clear();
     return true;
 }
 
@@ -395,18 +811,19 @@ void CollectionNotifier::detach()
 void CollectionNotifier::add_changes(CollectionChangeBuilder change)
 {
     std::lock_guard<std::mutex> lock(m_callback_mutex);
+    // The sequence number has to be consumed even if there's nothing to
+    // deliver so that pending calls to suppress_next_notification() are cleared
+    uint64_t sequence = m_change_count++;
+    if (m_callbacks.empty() || change.empty())
+        return;
+#ifdef REALM_DEBUG
     for (auto& callback : m_callbacks) {
-        if (callback.skip_next) {
-            REALM_ASSERT_DEBUG(callback.accumulated_changes.empty());
-            callback.skip_next = false;
-        }
-        else {
-            if (&callback == &m_callbacks.back())
-                callback.accumulated_changes.merge(std::move(change));
-            else
-                callback.accumulated_changes.merge(CollectionChangeBuilder(change));
-        }
+        if (callback.skipped_change == sequence)
+            REALM_ASSERT(none_of(begin(m_pending_changes), end(m_pending_changes),
+                                 [&](auto& pending) { return pending.first >= callback.first_change; }));
     }
+#endif
+    m_pending_changes.emplace_back(sequence, std::move(change));
 }
 
 NotifierPackage::NotifierPackage(std::exception_ptr error,
@@ -431,15 +848,24 @@ void NotifierPackage::package_and_wait(util::Optional<VersionID::version_type> t
         });
     });
 
+    // Notifiers are handed over individually as soon as they've run, so some
+    // of them may already be at a newer version than the others. Everything
+    // delivered has to be at the version the Realm is advanced to, so only
+    // package the ones at the newest version and leave the rest to be
+    // delivered once they've caught up.
+    util::Optional<VersionID> version;
+    for (auto& notifier : m_notifiers) {
+        if (notifier->has_run() && (!version || *version < notifier->version()))
+            version = notifier->version();
+    }
+
     // Package the notifiers for delivery and remove any which don't have anything to deliver
     auto package = [&](auto& notifier) {
-        if (notifier->has_run() && notifier->package_for_delivery()) {
-            m_version = notifier->version();
-            return false;
-        }
-        return true;
+        return !(notifier->has_run() && notifier->version() == *version && notifier->package_for_delivery());
     };
     m_notifiers.erase(std::remove_if(begin(m_notifiers), end(m_notifiers), package), end(m_notifiers));
+    if (!m_notifiers.empty())
+        m_version = version;
     if (m_version && target_version && m_version->version < *target_version) {
         m_notifiers.clear();
         m_version = util::none;
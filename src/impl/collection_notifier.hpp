@@ -20,6 +20,7 @@
 #define REALM_BACKGROUND_COLLECTION_HPP
 
 #include "impl/collection_change_builder.hpp"
+#include "util/flat_index_map.hpp"
 
 #include <realm/version_id.hpp>
 
@@ -27,10 +28,13 @@
 #include <atomic>
 #include <exception>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <unordered_map>
 
 namespace realm {
+class Group;
 class Realm;
 class SharedGroup;
 class Table;
@@ -48,11 +52,26 @@ struct ListChangeInfo {
 struct TransactionChangeInfo {
     std::vector<bool> table_modifications_needed;
     std::vector<bool> table_moves_needed;
+    // Tables for which the modified columns need to be tracked in addition to
+    // the modified rows. Only applies to tables whose modifications are needed.
+    std::vector<bool> table_columns_needed;
     std::vector<ListChangeInfo> lists;
     std::vector<CollectionChangeBuilder> tables;
     std::vector<std::vector<size_t>> column_indices;
     std::vector<size_t> table_indices;
     bool track_all;
+
+    // The rows of each table which link to a modified row, either directly
+    // or via other rows. Calculated once per transaction for all of the
+    // notifiers which share this info by
+    // DeepChangeChecker::calculate_modified_via_links().
+    std::vector<IndexSet> modified_via_links;
+    bool modified_via_links_calculated = false;
+    // Set if modified_via_links should be calculated the first time a
+    // notifier sharing this info needs to check for modifications via links.
+    // Those notifiers can be running on different threads, so this guards the
+    // calculation.
+    std::shared_ptr<std::mutex> modified_via_links_mutex;
 };
 
 class DeepChangeChecker {
@@ -60,10 +79,22 @@ public:
     struct OutgoingLink {
         size_t col_ndx;
         bool is_list;
+
+        bool operator==(OutgoingLink const& other) const noexcept
+        {
+            return col_ndx == other.col_ndx && is_list == other.is_list;
+        }
     };
     struct RelatedTable {
         size_t table_ndx;
         std::vector<OutgoingLink> links;
+        // The columns whose modification is reported, or empty for all of them
+        std::vector<size_t> columns;
+
+        bool operator==(RelatedTable const& other) const noexcept
+        {
+            return table_ndx == other.table_ndx && links == other.links && columns == other.columns;
+        }
     };
 
     DeepChangeChecker(TransactionChangeInfo const& info, Table const& root_table,
@@ -71,17 +102,52 @@ public:
 
     bool operator()(size_t row_ndx);
 
+    // Check all of the given rows of the root table at once, returning the
+    // set of those which were modified. The rows are checked in index order
+    // so that rows reachable from several of them are only walked once.
+    IndexSet modified_rows(std::vector<size_t> rows);
+
     // Recursively add `table` and all tables it links to to `out`, along with
     // information about the links from them
     static void find_related_tables(std::vector<RelatedTable>& out, Table const& table);
 
+    // Add the tables, links and columns needed to observe the given key paths
+    // from `table` to `out`. Each key path is a dot-separated sequence of
+    // property names where all but the last are links, and an empty list of
+    // key paths observes everything. Throws InvalidPropertyException if a key
+    // path names a property which does not exist or cannot be followed.
+    static void find_related_tables(std::vector<RelatedTable>& out, Table const& table,
+                                    std::vector<std::string> const& key_paths);
+
+    // Merge the tables, links and columns observed by `tables` into `out`
+    static void merge_related_tables(std::vector<RelatedTable>& out, std::vector<RelatedTable> const& tables);
+
+    // Populate info.modified_via_links by walking backlinks from the modified
+    // rows, which is much cheaper than following the links from every row
+    // checked by every notifier when only a few rows were modified
+    static void calculate_modified_via_links(TransactionChangeInfo& info, Group const& group);
+    // Calculate info.modified_via_links if it's meant to be calculated on
+    // demand and hasn't been yet
+    static void ensure_modified_via_links(TransactionChangeInfo& info, Group const& group);
+
+    // The maximum number of links followed from a row to find a modification
+    static const size_t max_depth = 16;
+
 private:
     TransactionChangeInfo const& m_info;
     Table const& m_root_table;
     const size_t m_root_table_ndx;
-    IndexSet const* const m_root_modifications;
     std::vector<IndexSet> m_not_modified;
+    // Rows found to be modified, mapped to the number of links between them
+    // and the modification, as they can only be reused from a depth which
+    // leaves that modification within the search limit
+    std::vector<util::FlatIndexMap> m_modified;
+    size_t m_found_depth = 0;
     std::vector<RelatedTable> const& m_related_tables;
+    // Whether only some of the columns of the related tables are observed,
+    // which the precalculated TransactionChangeInfo::modified_via_links doesn't
+    // take into account
+    const bool m_filtered;
 
     struct Path {
         size_t table;
@@ -89,8 +155,10 @@ private:
         size_t col;
         bool depth_exceeded;
     };
-    std::array<Path, 16> m_current_path;
+    std::array<Path, max_depth> m_current_path;
 
+    // Check if the row was directly modified in one of the observed columns
+    bool row_modified(size_t table_ndx, size_t row_ndx) const;
     bool check_row(Table const& table, size_t row_ndx, size_t depth = 0);
     bool check_outgoing_links(size_t table_ndx, Table const& table,
                               size_t row_ndx, size_t depth = 0);
@@ -116,7 +184,15 @@ public:
     // Add a callback to be called each time the collection changes
     // This can only be called from the target collection's thread
     // Returns a token which can be passed to remove_callback()
-    size_t add_callback(CollectionChangeCallback callback);
+    // `observed_tables` limits which changes to linked objects and which
+    // columns are reported to the callback, and should be produced by
+    // DeepChangeChecker::find_related_tables() from the callback's key paths.
+    // If empty, all changes are reported. As a notifier only calculates a
+    // single changeset, a callback may also be sent modifications observed by
+    // the notifier's other callbacks.
+    size_t add_callback(CollectionChangeCallback callback,
+                        NotificationPriority priority=NotificationPriority::Interactive,
+                        std::vector<DeepChangeChecker::RelatedTable> observed_tables={});
     // Remove a previously added token. The token is no longer valid after
     // calling this function and must not be used again. This function can be
     // called from any thread.
@@ -164,6 +240,12 @@ public:
     // precondition: RealmCoordinator::m_notifier_mutex is locked *or* is called on worker thread
     bool has_run() const noexcept { return m_has_run; }
 
+    // The notifier worker which this notifier is attached to and run on, where
+    // 0 is the coordinator's own notifier SharedGroup
+    // precondition: RealmCoordinator::m_notifier_mutex is locked *or* is called on worker thread
+    size_t worker_index() const noexcept { return m_worker_index; }
+    void set_worker_index(size_t index) noexcept { m_worker_index = index; }
+
     // Attach the handed-over query to `sg`. Must not be already attached to a SharedGroup.
     // precondition: RealmCoordinator::m_notifier_mutex is locked
     void attach_to(SharedGroup& sg);
@@ -180,6 +262,26 @@ public:
     // precondition: RealmCoordinator::m_notifier_mutex is unlocked
     virtual void run() = 0;
 
+    // Notifiers with the same non-empty fingerprint observe identical
+    // collections, so RealmCoordinator runs them on the same SharedGroup and
+    // only the first of them has to actually do the work each time
+    std::string const& fingerprint() const noexcept { return m_fingerprint; }
+
+    // Call run() on each of the notifiers, with notifiers which have the same
+    // fingerprint as an earlier one reusing the work it did rather than
+    // repeating it. All of the notifiers must be attached to the same SharedGroup.
+    // `on_ready` is called for each notifier as soon as it is done with,
+    // which for notifiers whose work is reused is after the last one reusing it.
+    // precondition: RealmCoordinator::m_notifier_mutex is unlocked
+    static void run_all(std::vector<std::shared_ptr<CollectionNotifier>> const& notifiers,
+                        std::function<void (CollectionNotifier&)> const& on_ready);
+    // Whether the most recent call to run_all() reused the work of an earlier
+    // notifier for this one rather than running it from scratch
+    bool last_run_was_shared() const noexcept { return m_last_run_shared; }
+    // Whether the most recent run calculated its changes from just the rows
+    // which changed rather than by diffing the full results
+    virtual bool last_run_was_incremental() const noexcept { return false; }
+
     // precondition: RealmCoordinator::m_notifier_mutex is locked
     void prepare_handover();
 
@@ -187,12 +289,26 @@ public:
     class Handle;
 
     bool have_callbacks() const noexcept { return m_have_callbacks; }
+    // The most urgent priority of any of the registered callbacks, or
+    // Interactive if there are none
+    NotificationPriority priority() const noexcept { return m_priority; }
 protected:
     void add_changes(CollectionChangeBuilder change);
     void set_table(Table const& table);
     std::unique_lock<std::mutex> lock_target();
 
-    std::function<bool (size_t)> get_modification_checker(TransactionChangeInfo const&, Table const&);
+    std::function<bool (size_t)> get_modification_checker(TransactionChangeInfo&, Table const&);
+    // Get the subset of `rows` in the root table which were modified, either
+    // directly or via links
+    IndexSet get_modified_rows(TransactionChangeInfo&, Table const&, std::vector<size_t> rows);
+    void set_fingerprint(std::string fingerprint) { m_fingerprint = std::move(fingerprint); }
+    // Check if any of the tables reachable via links from the root table had
+    // rows modified, optionally ignoring one of them (typically the root table)
+    bool related_table_modified(TransactionChangeInfo const&, size_t ignored_table_ndx=-1) const;
+    // Check if any of the columns observed by the callbacks were modified.
+    // Unlike related_table_modified(), this ignores changes which can only
+    // affect which rows are in the collection and not what is reported.
+    bool observed_table_modified(TransactionChangeInfo const&) const;
 
 private:
     virtual void do_attach_to(SharedGroup&) = 0;
@@ -200,6 +316,15 @@ private:
     virtual void do_prepare_handover(SharedGroup&) = 0;
     virtual bool do_add_required_change_info(TransactionChangeInfo&) = 0;
     virtual bool prepare_to_deliver() { return true; }
+    // Whether changes to all of the related tables need to be tracked even
+    // if no callback observes them, because they can change which rows are
+    // in the collection
+    virtual bool needs_all_related_tables() const noexcept { return false; }
+
+    // Run using the result of the most recent call to run() on `source`, which
+    // has the same fingerprint as this notifier. Returns false if `source` has
+    // nothing which can be reused, in which case run() is called instead.
+    virtual bool run_from(CollectionNotifier&) { return false; }
 
     mutable std::mutex m_realm_mutex;
     std::shared_ptr<Realm> m_realm;
@@ -209,27 +334,55 @@ private:
 
     bool m_has_run = false;
     bool m_error = false;
+    size_t m_worker_index = 0;
+    std::string m_fingerprint;
+    bool m_last_run_shared = false;
     std::vector<DeepChangeChecker::RelatedTable> m_related_tables;
+    // The subset of m_related_tables observed by the callbacks, updated from
+    // the callbacks by add_required_change_info() when they've changed
+    std::vector<DeepChangeChecker::RelatedTable> m_observed_tables;
+    bool m_observed_tables_changed = false;
+    void update_observed_tables();
 
     struct Callback {
         CollectionChangeCallback fn;
-        CollectionChangeBuilder accumulated_changes;
-        CollectionChangeSet changes_to_deliver;
+        // The changes prepared by package_for_delivery(). Callbacks which were
+        // sent the same changes share a single changeset.
+        std::shared_ptr<CollectionChangeSet const> changes_to_deliver;
+        // Whether changes_to_deliver was built by finalize_lazily(), which is
+        // done if every callback sharing it takes a CollectionChangeView
+        bool changes_are_lazy;
         size_t token;
+        // The sequence number of the first change passed to add_changes()
+        // which should be delivered to this callback, and of a change which
+        // should not be due to suppress_next_notification()
+        uint64_t first_change;
+        uint64_t skipped_change;
         bool initial_delivered;
-        bool skip_next;
+        NotificationPriority priority;
+        std::vector<DeepChangeChecker::RelatedTable> observed_tables;
     };
 
     // Currently registered callbacks and a mutex which must always be held
-    // while doing anything with them or m_callback_index
+    // while doing anything with them, m_callback_index, m_pending_changes or
+    // m_observed_tables_changed
     std::mutex m_callback_mutex;
     std::vector<Callback> m_callbacks;
 
+    // The changes passed to add_changes() which have not yet been packaged
+    // for delivery, along with their sequence numbers. These are stored once
+    // for all callbacks rather than being copied into each of them.
+    std::vector<std::pair<uint64_t, CollectionChangeBuilder>> m_pending_changes;
+    uint64_t m_change_count = 0;
+
     // Cached value for if m_callbacks is empty, needed to avoid deadlocks in
     // run() due to lock-order inversion between m_callback_mutex and m_target_mutex
     // It's okay if this value is stale as at worst it'll result in us doing
     // some extra work.
     std::atomic<bool> m_have_callbacks = {false};
+    // Cached value of priority(), which may be stale in the same way
+    std::atomic<NotificationPriority> m_priority = {NotificationPriority::Interactive};
+    void update_priority();
 
     // Iteration variable for looping over callbacks
     // remove_callback() updates this when needed
@@ -160,13 +160,75 @@ ExternalCommitHelper::ExternalCommitHelper(RealmCoordinator& parent)
         throw std::system_error(errno, std::system_category());
     }
 
+    m_use_notifier_thread = parent.get_config().dedicated_notifier_thread;
+
     // Lock is inside add_commit_helper.
     DaemonThread::shared().add_commit_helper(this);
+
+    if (m_use_notifier_thread) {
+        m_notifier_thread = std::thread([this] {
+            try {
+                notifier_thread_loop();
+            }
+            catch (std::exception const& e) {
+                LOGE("uncaught exception in notifier thread: %s: %s\n", typeid(e).name(), e.what());
+                throw;
+            }
+            catch (...) {
+                LOGE("uncaught exception in notifier thread\n");
+                throw;
+            }
+        });
+    }
 }
 
 ExternalCommitHelper::~ExternalCommitHelper()
 {
     DaemonThread::shared().remove_commit_helper(this);
+
+    if (m_use_notifier_thread) {
+        // Called from on_change(), dead lock will happen.
+        REALM_ASSERT(std::this_thread::get_id() != m_notifier_thread.get_id());
+        {
+            std::lock_guard<std::mutex> lock(m_pending_mutex);
+            m_shutdown = true;
+        }
+        m_pending_cv.notify_one();
+        m_notifier_thread.join();
+    }
+}
+
+void ExternalCommitHelper::on_notify()
+{
+    if (!m_use_notifier_thread) {
+        m_parent.on_change();
+        return;
+    }
+
+    // Multiple wakeups which arrive while the notifier thread is busy are
+    // coalesced into a single call to on_change()
+    {
+        std::lock_guard<std::mutex> lock(m_pending_mutex);
+        m_change_pending = true;
+    }
+    m_pending_cv.notify_one();
+}
+
+void ExternalCommitHelper::notifier_thread_loop()
+{
+    pthread_setname_np(pthread_self(), "Realm notifier");
+
+    std::unique_lock<std::mutex> lock(m_pending_mutex);
+    while (true) {
+        m_pending_cv.wait(lock, [&] { return m_change_pending || m_shutdown; });
+        if (m_shutdown)
+            return;
+        m_change_pending = false;
+
+        lock.unlock();
+        m_parent.on_change();
+        lock.lock();
+    }
 }
 
 ExternalCommitHelper::DaemonThread::DaemonThread()
@@ -289,7 +351,7 @@ void ExternalCommitHelper::DaemonThread::listen()
             std::lock_guard<std::mutex> lock(m_mutex);
             for (auto helper : m_helpers) {
                 if (ev.data.u32 == (uint32_t)helper->m_notify_fd) {
-                    helper->m_parent.on_change();
+                    helper->on_notify();
                 }
             }
         }
@@ -16,6 +16,7 @@
 //
 ////////////////////////////////////////////////////////////////////////////
 
+#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <thread>
@@ -63,6 +64,21 @@ private:
     // Read-write file descriptor for the named pipe which is waited on for
     // changes and written to when a commit is made
     FdHolder m_notify_fd;
+
+    // If the coordinator requested a dedicated notifier thread, the shared
+    // daemon thread only flags that a change is pending and on_change() is
+    // called on m_notifier_thread instead, so that slow notifiers for one
+    // file don't delay notifications for other files
+    bool m_use_notifier_thread = false;
+    std::mutex m_pending_mutex;
+    std::condition_variable m_pending_cv;
+    bool m_change_pending = false;
+    bool m_shutdown = false;
+    std::thread m_notifier_thread;
+
+    // Called on the daemon thread when the named pipe is written to
+    void on_notify();
+    void notifier_thread_loop();
 };
 
 } // namespace _impl
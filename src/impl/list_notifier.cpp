@@ -95,22 +95,26 @@ void ListNotifier::run()
         return;
     }
 
-    auto row_did_change = get_modification_checker(*m_info, m_lv->get_target_table());
-    for (size_t i = 0; i < m_lv->size(); ++i) {
-        if (m_change.modifications.contains(i))
-            continue;
-        if (row_did_change(m_lv->get(i).get_index()))
-            m_change.modifications.add(i);
-    }
+    m_prev_size = m_lv->size();
 
-    for (auto const& move : m_change.moves) {
-        if (m_change.modifications.contains(move.to))
-            continue;
-        if (row_did_change(m_lv->get(move.to).get_index()))
-            m_change.modifications.add(move.to);
-    }
+    // Nothing the list links to was modified, so only changes to the list
+    // itself need to be reported and there's no need to check every row
+    if (!observed_table_modified(*m_info))
+        return;
 
-    m_prev_size = m_lv->size();
+    // Gather up all of the target rows first so that they can be checked as a
+    // single batch, which lets rows linked to from several entries in the
+    // list share the work of walking their links
+    std::vector<size_t> rows;
+    rows.reserve(m_lv->size());
+    for (size_t i = 0; i < m_lv->size(); ++i)
+        rows.push_back(m_lv->get(i).get_index());
+
+    auto modified = get_modified_rows(*m_info, m_lv->get_target_table(), rows);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (modified.contains(rows[i]))
+            m_change.modifications.add(i);
+    }
 }
 
 void ListNotifier::do_prepare_handover(SharedGroup&)
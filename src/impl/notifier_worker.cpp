@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2017 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "impl/notifier_worker.hpp"
+
+#include "impl/collection_notifier.hpp"
+#include "impl/transact_log_handler.hpp"
+
+#include <realm/group_shared.hpp>
+
+using namespace realm;
+using namespace realm::_impl;
+
+NotifierWorker::NotifierWorker(Realm::Config const& config)
+{
+    std::unique_ptr<Group> read_only_group;
+    Realm::open_with_config(config, m_history, m_sg, read_only_group, nullptr);
+    REALM_ASSERT(!read_only_group);
+
+    m_thread = std::thread([this] { work_loop(); });
+}
+
+NotifierWorker::~NotifierWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_shutdown = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+}
+
+void NotifierWorker::run(VersionID version,
+                         std::vector<std::shared_ptr<CollectionNotifier>> new_notifiers,
+                         std::vector<std::shared_ptr<CollectionNotifier>> notifiers,
+                         std::function<void (CollectionNotifier&)> on_ready)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        REALM_ASSERT(!m_running);
+        m_version = version;
+        m_new_notifiers = std::move(new_notifiers);
+        m_notifiers = std::move(notifiers);
+        m_on_ready = std::move(on_ready);
+        m_running = true;
+    }
+    m_cv.notify_all();
+}
+
+void NotifierWorker::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [&] { return !m_running; });
+    if (auto error = std::move(m_error)) {
+        m_error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void NotifierWorker::end_read()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    REALM_ASSERT(!m_running);
+    if (m_sg->get_transact_stage() == SharedGroup::transact_Reading)
+        m_sg->end_read();
+}
+
+void NotifierWorker::work_loop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cv.wait(lock, [&] { return m_running || m_shutdown; });
+        if (m_shutdown)
+            return;
+
+        // The coordinator doesn't touch anything we use until m_running is
+        // cleared, so the lock doesn't need to be held while running
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            do_run();
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+
+        m_error = std::move(error);
+        m_new_notifiers.clear();
+        m_notifiers.clear();
+        m_on_ready = nullptr;
+        m_running = false;
+        m_cv.notify_all();
+    }
+}
+
+void NotifierWorker::do_run()
+{
+    if (m_sg->get_transact_stage() == SharedGroup::transact_Ready)
+        m_sg->begin_read(m_version);
+    else
+        transaction::advance(*m_sg, nullptr, m_version);
+
+    for (auto& notifier : m_new_notifiers)
+        notifier->attach_to(*m_sg);
+    m_new_notifiers.insert(m_new_notifiers.end(), m_notifiers.begin(), m_notifiers.end());
+    CollectionNotifier::run_all(m_new_notifiers, m_on_ready);
+}
@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2017 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_NOTIFIER_WORKER_HPP
+#define REALM_NOTIFIER_WORKER_HPP
+
+#include "shared_realm.hpp"
+
+#include <realm/version_id.hpp>
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace realm {
+class Replication;
+class SharedGroup;
+
+namespace _impl {
+class CollectionNotifier;
+
+// A thread with its own SharedGroup which async notifiers can be permanently
+// attached to, so that RealmCoordinator can run several notifiers in parallel.
+// The SharedGroup is only ever used by one thread at a time: the worker thread
+// between run() and wait(), and the coordinator's notifier thread otherwise.
+class NotifierWorker {
+public:
+    // Opens a new SharedGroup for the file. Throws if it cannot be opened.
+    NotifierWorker(Realm::Config const& config);
+    ~NotifierWorker();
+
+    // Asynchronously advance this worker's SharedGroup to `version`, attach
+    // `new_notifiers` to it, and then call run() on all of the given notifiers.
+    // `on_ready` is called on the worker thread for each notifier once it has
+    // been run. The change info for the notifiers must already have been calculated.
+    void run(VersionID version,
+             std::vector<std::shared_ptr<CollectionNotifier>> new_notifiers,
+             std::vector<std::shared_ptr<CollectionNotifier>> notifiers,
+             std::function<void (CollectionNotifier&)> on_ready);
+
+    // Wait for the work started by the previous call to run() to complete,
+    // rethrowing any exception it produced. No-op if nothing is running.
+    void wait();
+
+    // Release the read transaction, which must not have any notifiers
+    // attached to it. Must not be called while running.
+    void end_read();
+
+private:
+    std::unique_ptr<Replication> m_history;
+    std::unique_ptr<SharedGroup> m_sg;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+
+    // The work for the current call to run(), guarded by m_mutex
+    VersionID m_version;
+    std::vector<std::shared_ptr<CollectionNotifier>> m_new_notifiers;
+    std::vector<std::shared_ptr<CollectionNotifier>> m_notifiers;
+    std::function<void (CollectionNotifier&)> m_on_ready;
+    bool m_running = false;
+    bool m_shutdown = false;
+    std::exception_ptr m_error;
+
+    std::thread m_thread;
+
+    void work_loop();
+    void do_run();
+};
+
+} // namespace _impl
+} // namespace realm
+
+#endif // REALM_NOTIFIER_WORKER_HPP
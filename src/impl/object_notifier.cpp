@@ -63,6 +63,10 @@ bool ObjectNotifier::do_add_required_change_info(TransactionChangeInfo& info)
         if (table_ndx >= info.table_modifications_needed.size())
             info.table_modifications_needed.resize(table_ndx + 1);
         info.table_modifications_needed[table_ndx] = true;
+        // The changeset reports which properties of the object changed
+        if (table_ndx >= info.table_columns_needed.size())
+            info.table_columns_needed.resize(table_ndx + 1);
+        info.table_columns_needed[table_ndx] = true;
     }
     return false;
 }
@@ -20,6 +20,7 @@
 
 #include "impl/collection_notifier.hpp"
 #include "impl/external_commit_helper.hpp"
+#include "impl/notifier_worker.hpp"
 #include "impl/transact_log_handler.hpp"
 #include "impl/weak_realm_notifier.hpp"
 #include "binding_context.hpp"
@@ -376,6 +377,19 @@ void RealmCoordinator::assert_no_open_realms() noexcept
 
 void RealmCoordinator::wake_up_notifier_worker()
 {
+    std::lock_guard<std::mutex> lock(m_notifier_mutex);
+    request_notifier_run();
+}
+
+void RealmCoordinator::request_notifier_run()
+{
+    // End any rate-limiting delay early, as someone needs the notifiers to run.
+    // The flag is only read with m_notifier_mutex held, so setting it with the
+    // mutex held means the wakeup can't be lost between the delay checking it
+    // and starting to wait.
+    m_notifier_run_requested = true;
+    m_notifier_interval_cv.notify_all();
+
     if (m_notifier) {
         // FIXME: this wakes up the notification workers for all processes and
         // not just us. This might be worth optimizing in the future.
@@ -498,6 +512,17 @@ void RealmCoordinator::clean_up_dead_notifiers()
             m_notifier_sg->end_read();
             m_notifier_skip_version = {0, 0};
         }
+
+        // Likewise for any workers which no longer have notifiers attached
+        if (!m_notifier_workers.empty()) {
+            std::vector<bool> in_use(m_notifier_workers.size() + 1);
+            for (auto& notifier : m_notifiers)
+                in_use[notifier->worker_index()] = true;
+            for (size_t i = 0; i < m_notifier_workers.size(); ++i) {
+                if (!in_use[i + 1])
+                    m_notifier_workers[i]->end_read();
+            }
+        }
     }
     if (swap_remove(m_new_notifiers) && m_advancer_sg) {
         REALM_ASSERT_3(m_advancer_sg->get_transact_stage(), ==, SharedGroup::transact_Reading);
@@ -509,6 +534,7 @@ void RealmCoordinator::clean_up_dead_notifiers()
 
 void RealmCoordinator::on_change()
 {
+    wait_for_notifier_interval();
     run_async_notifiers();
 
     std::lock_guard<std::mutex> lock(m_realm_mutex);
@@ -517,6 +543,42 @@ void RealmCoordinator::on_change()
     }
 }
 
+void RealmCoordinator::wait_for_notifier_interval()
+{
+    auto interval = std::chrono::milliseconds(m_config.async_notifier_min_interval_ms);
+    if (interval.count() == 0)
+        return;
+
+    std::unique_lock<std::mutex> lock(m_notifier_mutex);
+    if (m_notifiers.empty() && m_new_notifiers.empty())
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = m_last_notifier_run + interval;
+    if (start >= deadline)
+        return;
+
+    // Any commits made while we wait will be picked up by the run at the end,
+    // and the wakeups for them will find that there's nothing new to do
+    bool expedited = m_notifier_interval_cv.wait_until(lock, deadline, [&] {
+        return m_notifier_run_requested || m_notifier_waiters > 0;
+    });
+
+    auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    auto& stats = m_notifier_statistics;
+    ++stats.delayed_runs;
+    if (expedited)
+        ++stats.expedited_runs;
+    stats.total_delay += delay;
+    stats.max_delay = std::max(stats.max_delay, delay);
+}
+
+RealmCoordinator::NotifierStatistics RealmCoordinator::get_notifier_statistics()
+{
+    std::lock_guard<std::mutex> lock(m_notifier_mutex);
+    return m_notifier_statistics;
+}
+
 namespace {
 class IncrementalChangeInfo {
 public:
@@ -556,6 +618,7 @@ public:
             m_info.push_back({
                 m_current->table_modifications_needed,
                 m_current->table_moves_needed,
+                m_current->table_columns_needed,
                 std::move(m_current->lists)});
             m_current = &m_info.back();
             return true;
@@ -585,8 +648,17 @@ public:
                 continue;
             }
 
+            // `cur` has to be left intact for the notifiers which started at
+            // its version, so merging requires a copy of it. Most tables
+            // aren't changed in most transactions, so avoid copying the ones
+            // which are empty or have nothing to merge into.
             for (size_t j = 0; j < prev.tables.size() && j < cur.tables.size(); ++j) {
-                prev.tables[j].merge(CollectionChangeBuilder{cur.tables[j]});
+                if (cur.tables[j].empty())
+                    continue;
+                if (prev.tables[j].empty())
+                    prev.tables[j] = cur.tables[j];
+                else
+                    prev.tables[j].merge(CollectionChangeBuilder{cur.tables[j]});
             }
             prev.tables.reserve(cur.tables.size());
             while (prev.tables.size() < cur.tables.size()) {
@@ -603,6 +675,17 @@ public:
                 }
             }
         }
+
+        // Have the rows which can reach the modifications via links worked
+        // out once by the first notifier which needs them, rather than having
+        // each notifier search from all of its rows. Doing it on demand skips
+        // the work for infos which no notifier checks for deep changes.
+        for (auto& info : m_info) {
+            if (info.track_all || std::any_of(info.table_modifications_needed.begin(),
+                                              info.table_modifications_needed.end(),
+                                              [](bool needed) { return needed; }))
+                info.modified_via_links_mutex = std::make_shared<std::mutex>();
+        }
     }
 
 private:
@@ -622,6 +705,9 @@ void RealmCoordinator::run_async_notifiers()
         return;
     }
 
+    m_last_notifier_run = std::chrono::steady_clock::now();
+    m_notifier_run_requested = false;
+
     if (!m_async_error) {
         open_helper_shared_group();
     }
@@ -684,12 +770,18 @@ void RealmCoordinator::run_async_notifiers()
     }
     REALM_ASSERT_3(m_advancer_sg->get_transact_stage(), ==, SharedGroup::transact_Ready);
 
+    ++m_notifier_statistics.runs;
+    if (m_last_notifier_version && version.version > m_last_notifier_version)
+        m_notifier_statistics.versions += version.version - m_last_notifier_version;
+    m_last_notifier_version = version.version;
+
     auto skip_version = m_notifier_skip_version;
     m_notifier_skip_version = {0, 0};
 
     // Make a copy of the notifiers vector and then release the lock to avoid
     // blocking other threads trying to register or unregister notifiers while we run them
     auto notifiers = m_notifiers;
+    assign_notifier_workers(new_notifiers);
     m_notifiers.insert(m_notifiers.end(), new_notifiers.begin(), new_notifiers.end());
     lock.unlock();
 
@@ -701,13 +793,7 @@ void RealmCoordinator::run_async_notifiers()
             notifier->add_required_change_info(change_info.current());
         change_info.advance_to_final(skip_version);
 
-        for (auto& notifier : notifiers)
-            notifier->run();
-
-        lock.lock();
-        for (auto& notifier : notifiers)
-            notifier->prepare_handover();
-        lock.unlock();
+        run_notifiers(skip_version, {}, notifiers);
     }
 
     // Advance the non-new notifiers to the same version as we advanced the new
@@ -718,31 +804,134 @@ void RealmCoordinator::run_async_notifiers()
     }
     change_info.advance_to_final(version);
 
-    // Attach the new notifiers to the main SG and move them to the main list
-    for (auto& notifier : new_notifiers) {
-        notifier->attach_to(*m_notifier_sg);
-        notifier->run();
-    }
-
     // Change info is now all ready, so the notifiers can now perform their
-    // background work
-    for (auto& notifier : notifiers) {
-        notifier->run();
+    // background work. This is done one priority class at a time so that
+    // threads waiting on interactive notifiers aren't held up by bulk work.
+    // A Realm with notifiers in several priority classes can therefore
+    // briefly have them at different versions (as can the skip_version run
+    // above), which NotifierPackage accounts for when delivering.
+    using NotifierVector = std::vector<std::shared_ptr<_impl::CollectionNotifier>>;
+    const size_t priority_count = size_t(NotificationPriority::Bulk) + 1;
+    NotifierVector new_by_priority[priority_count];
+    NotifierVector by_priority[priority_count];
+    for (auto& notifier : new_notifiers)
+        new_by_priority[size_t(notifier->priority())].push_back(notifier);
+    for (auto& notifier : notifiers)
+        by_priority[size_t(notifier->priority())].push_back(notifier);
+
+    for (size_t i = 0; i < priority_count; ++i) {
+        if (new_by_priority[i].empty() && by_priority[i].empty())
+            continue;
+        run_notifiers(version, new_by_priority[i], by_priority[i]);
     }
 
-    // Reacquire the lock while updating the fields that are actually read on
-    // other threads
     lock.lock();
-    for (auto& notifier : new_notifiers) {
-        notifier->prepare_handover();
-    }
-    for (auto& notifier : notifiers) {
-        notifier->prepare_handover();
-    }
     clean_up_dead_notifiers();
     m_notifier_cv.notify_all();
 }
 
+void RealmCoordinator::run_notifiers(VersionID version,
+                                     std::vector<std::shared_ptr<_impl::CollectionNotifier>> const& new_notifiers,
+                                     std::vector<std::shared_ptr<_impl::CollectionNotifier>> const& notifiers)
+{
+    // Each notifier is handed over as soon as it's done rather than after all
+    // of them have run, so that a Realm waiting on its own notifiers doesn't
+    // also have to wait for the ones belonging to other Realms. This means
+    // that a Realm's notifiers can briefly be at different versions;
+    // NotifierPackage only delivers the ones which share a version.
+    auto on_ready = [this](CollectionNotifier& notifier) {
+        std::lock_guard<std::mutex> lock(m_notifier_mutex);
+        if (notifier.last_run_was_shared())
+            ++m_notifier_statistics.shared_runs;
+        if (notifier.last_run_was_incremental())
+            ++m_notifier_statistics.incremental_diffs;
+        notifier.prepare_handover();
+        if (m_notifier_waiters)
+            m_notifier_cv.notify_all();
+    };
+
+    if (m_notifier_workers.empty()) {
+        // Attach the new notifiers to the main SG before running them
+        auto all_notifiers = new_notifiers;
+        for (auto& notifier : new_notifiers)
+            notifier->attach_to(*m_notifier_sg);
+        all_notifiers.insert(all_notifiers.end(), notifiers.begin(), notifiers.end());
+        CollectionNotifier::run_all(all_notifiers, on_ready);
+        return;
+    }
+
+    // Hand each worker the notifiers attached to it, and run the ones attached
+    // to the main SG on this thread while they're busy
+    using NotifierVector = std::vector<std::shared_ptr<_impl::CollectionNotifier>>;
+    std::vector<NotifierVector> new_for_worker(m_notifier_workers.size() + 1);
+    std::vector<NotifierVector> for_worker(m_notifier_workers.size() + 1);
+    for (auto& notifier : new_notifiers)
+        new_for_worker[notifier->worker_index()].push_back(notifier);
+    for (auto& notifier : notifiers)
+        for_worker[notifier->worker_index()].push_back(notifier);
+
+    std::vector<bool> started(m_notifier_workers.size());
+    for (size_t i = 0; i < m_notifier_workers.size(); ++i) {
+        if (new_for_worker[i + 1].empty() && for_worker[i + 1].empty())
+            continue;
+        m_notifier_workers[i]->run(version, std::move(new_for_worker[i + 1]), std::move(for_worker[i + 1]), on_ready);
+        started[i] = true;
+    }
+
+    // The workers have to be joined even if running one of the notifiers
+    // throws, as they're using the notifiers and their change info
+    std::exception_ptr error;
+    try {
+        for (auto& notifier : new_for_worker[0])
+            notifier->attach_to(*m_notifier_sg);
+        new_for_worker[0].insert(new_for_worker[0].end(), for_worker[0].begin(), for_worker[0].end());
+        CollectionNotifier::run_all(new_for_worker[0], on_ready);
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+
+    for (size_t i = 0; i < m_notifier_workers.size(); ++i) {
+        if (!started[i])
+            continue;
+        try {
+            m_notifier_workers[i]->wait();
+        }
+        catch (...) {
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void RealmCoordinator::assign_notifier_workers(std::vector<std::shared_ptr<_impl::CollectionNotifier>> const& new_notifiers)
+{
+    if (m_notifier_workers.empty())
+        return;
+
+    // Put each new notifier on the same worker as any existing notifiers
+    // which observe the same thing, so that the work can be shared between
+    // them, and otherwise on whichever worker currently has the fewest
+    std::vector<size_t> load(m_notifier_workers.size() + 1);
+    std::unordered_map<std::string, size_t> worker_for_fingerprint;
+    for (auto& notifier : m_notifiers) {
+        ++load[notifier->worker_index()];
+        if (!notifier->fingerprint().empty())
+            worker_for_fingerprint[notifier->fingerprint()] = notifier->worker_index();
+    }
+    for (auto& notifier : new_notifiers) {
+        size_t worker = std::min_element(load.begin(), load.end()) - load.begin();
+        if (!notifier->fingerprint().empty()) {
+            auto it = worker_for_fingerprint.emplace(notifier->fingerprint(), worker).first;
+            worker = it->second;
+        }
+        notifier->set_worker_index(worker);
+        ++load[worker];
+    }
+}
+
 void RealmCoordinator::open_helper_shared_group()
 {
     if (!m_notifier_sg) {
@@ -751,12 +940,16 @@ void RealmCoordinator::open_helper_shared_group()
             Realm::open_with_config(m_config, m_notifier_history, m_notifier_sg, read_only_group, nullptr);
             REALM_ASSERT(!read_only_group);
             m_notifier_sg->begin_read();
+
+            for (size_t i = 1; i < m_config.async_notifier_threads; ++i)
+                m_notifier_workers.push_back(std::make_unique<NotifierWorker>(m_config));
         }
         catch (...) {
             // Store the error to be passed to the async notifiers
             m_async_error = std::current_exception();
             m_notifier_sg = nullptr;
             m_notifier_history = nullptr;
+            m_notifier_workers.clear();
         }
     }
     else if (m_notifiers.empty()) {
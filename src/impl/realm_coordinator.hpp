@@ -23,6 +23,7 @@
 
 #include <realm/version_id.hpp>
 
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 
@@ -36,6 +37,7 @@ class SyncSession;
 namespace _impl {
 class CollectionNotifier;
 class ExternalCommitHelper;
+class NotifierWorker;
 class WeakRealmNotifier;
 
 // RealmCoordinator manages the weak cache of Realm instances and communication
@@ -137,6 +139,29 @@ public:
     template<typename Pred>
     std::unique_lock<std::mutex> wait_for_notifiers(Pred&& wait_predicate);
 
+    struct NotifierStatistics {
+        // The number of times the async notifiers have been run
+        uint64_t runs = 0;
+        // The total number of versions the notifiers were advanced by over all
+        // of the runs, so versions / runs is the average number of commits
+        // coalesced into each run
+        uint64_t versions = 0;
+        // The number of times a notifier reused the work done for an identical
+        // notifier rather than rerunning its query
+        uint64_t shared_runs = 0;
+        // The number of times a notifier calculated its changes from just the
+        // rows which changed rather than diffing its full results
+        uint64_t incremental_diffs = 0;
+        // The number of runs which were delayed by async_notifier_min_interval_ms,
+        // and how many of those were cut short because a thread needed them
+        uint64_t delayed_runs = 0;
+        uint64_t expedited_runs = 0;
+        // The total and longest time spent delaying runs
+        std::chrono::milliseconds total_delay{0};
+        std::chrono::milliseconds max_delay{0};
+    };
+    NotifierStatistics get_notifier_statistics();
+
 private:
     Realm::Config m_config;
 
@@ -167,6 +192,21 @@ private:
     std::unique_ptr<SharedGroup> m_advancer_sg;
     std::exception_ptr m_async_error;
 
+    // Additional threads for running notifiers in parallel with the ones
+    // attached to m_notifier_sg. Notifiers with a worker_index() of `i` are
+    // attached to m_notifier_workers[i - 1].
+    std::vector<std::unique_ptr<_impl::NotifierWorker>> m_notifier_workers;
+
+    // State for rate limiting runs of the notifiers, guarded by m_notifier_mutex.
+    // m_notifier_run_requested is set when someone needs the notifiers to
+    // run as soon as possible.
+    std::condition_variable m_notifier_interval_cv;
+    std::chrono::steady_clock::time_point m_last_notifier_run;
+    uint_fast64_t m_last_notifier_version = 0;
+    size_t m_notifier_waiters = 0;
+    bool m_notifier_run_requested = false;
+    NotifierStatistics m_notifier_statistics;
+
     std::unique_ptr<_impl::ExternalCommitHelper> m_notifier;
     std::function<void(VersionID, VersionID)> m_transaction_callback;
 
@@ -174,11 +214,19 @@ private:
 
     // must be called with m_notifier_mutex locked
     void pin_version(VersionID version);
+    // Wake up the notifier thread, ending any rate-limiting delay
+    // must be called with m_notifier_mutex locked
+    void request_notifier_run();
 
     void set_config(const Realm::Config&);
     void create_sync_session();
 
+    void wait_for_notifier_interval();
     void run_async_notifiers();
+    void run_notifiers(VersionID version,
+                       std::vector<std::shared_ptr<_impl::CollectionNotifier>> const& new_notifiers,
+                       std::vector<std::shared_ptr<_impl::CollectionNotifier>> const& notifiers);
+    void assign_notifier_workers(std::vector<std::shared_ptr<_impl::CollectionNotifier>> const& new_notifiers);
     void open_helper_shared_group();
     void advance_helper_shared_group_to_latest();
     void clean_up_dead_notifiers();
@@ -192,15 +240,17 @@ std::unique_lock<std::mutex> RealmCoordinator::wait_for_notifiers(Pred&& wait_pr
 {
     std::unique_lock<std::mutex> lock(m_notifier_mutex);
     bool first = true;
+    ++m_notifier_waiters;
     m_notifier_cv.wait(lock, [&] {
         if (wait_predicate())
             return true;
         if (first) {
-            wake_up_notifier_worker();
+            request_notifier_run();
             first = false;
         }
         return false;
     });
+    --m_notifier_waiters;
     return lock;
 }
 
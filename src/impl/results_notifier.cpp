@@ -25,12 +25,36 @@ ResultsNotifier::ResultsNotifier(Results& target)
 : CollectionNotifier(target.get_realm())
 , m_target_results(&target)
 , m_target_is_in_table_order(target.is_in_table_order())
+, m_max_diff_rows(target.get_realm()->config().async_notifier_max_diff_rows)
 {
+    if (!m_max_diff_rows)
+        m_max_diff_rows = npos;
+
     Query q = target.get_query();
     set_table(*q.get_table());
     m_query_handover = Realm::Internal::get_shared_group(*get_realm())->export_for_handover(q, MutableSourcePayload::Move);
     SortDescriptor::generate_patch(target.get_sort(), m_sort_handover);
     SortDescriptor::generate_patch(target.get_distinct(), m_distinct_handover);
+
+    // We can only tell that two queries are identical if neither has any
+    // conditions, in which case they're identified by the table and the
+    // sort and distinct columns
+    if (Results::Internal::query_matches_all_rows(target)) {
+        std::string fingerprint = std::to_string(q.get_table()->get_index_in_group());
+        auto append_descriptor = [&](char prefix, SortDescriptor::HandoverPatch const& patch) {
+            if (!patch)
+                return;
+            fingerprint += prefix;
+            for (size_t i = 0; i < patch->columns.size(); ++i) {
+                for (auto col : patch->columns[i])
+                    fingerprint += std::to_string(col) + '.';
+                fingerprint += i < patch->ascending.size() && !patch->ascending[i] ? '-' : '+';
+            }
+        };
+        append_descriptor('s', m_sort_handover);
+        append_descriptor('d', m_distinct_handover);
+        set_fingerprint(std::move(fingerprint));
+    }
 }
 
 void ResultsNotifier::target_results_moved(Results& old_target, Results& new_target)
@@ -77,7 +101,8 @@ bool ResultsNotifier::do_add_required_change_info(TransactionChangeInfo& info)
         info.table_moves_needed.resize(table_ndx + 1);
     info.table_moves_needed[table_ndx] = true;
 
-    return has_run() && have_callbacks();
+    m_modifications_tracked = has_run() && have_callbacks();
+    return m_modifications_tracked;
 }
 
 bool ResultsNotifier::need_to_run()
@@ -85,13 +110,9 @@ bool ResultsNotifier::need_to_run()
     REALM_ASSERT(m_info);
     REALM_ASSERT(!m_tv.is_attached());
 
-    {
-        auto lock = lock_target();
-        // Don't run the query if the results aren't actually going to be used
-        if (!get_realm() || (!have_callbacks() && !m_target_results->wants_background_updates())) {
-            return false;
-        }
-    }
+    // Don't run the query if the results aren't actually going to be used
+    if (is_abandoned())
+        return false;
 
     // If we've run previously, check if we need to rerun
     if (has_run() && m_query->sync_view_if_needed() == m_last_seen_version) {
@@ -101,12 +122,55 @@ bool ResultsNotifier::need_to_run()
     return true;
 }
 
+bool ResultsNotifier::is_abandoned()
+{
+    auto lock = lock_target();
+    return !get_realm() || (!have_callbacks() && !m_target_results->wants_background_updates());
+}
+
+// If the last callback is removed or the Results is destroyed while we're
+// running, stop as soon as possible and leave things as if need_to_run() had
+// returned false. The query is rerun from scratch the next time it's needed.
+void ResultsNotifier::abandon_run()
+{
+    m_tv = {};
+    m_changes = {};
+    m_last_seen_version = -1;
+}
+
 void ResultsNotifier::calculate_changes()
 {
     size_t table_ndx = m_query->get_table()->get_index_in_group();
     if (has_run()) {
         auto changes = table_ndx < m_info->tables.size() ? &m_info->tables[table_ndx] : nullptr;
 
+        // The table version is bumped by writes to any table linked to from
+        // the query's table and by writes which didn't actually change
+        // anything, so the query may have been rerun even though none of the
+        // rows it could have matched were touched. If so, and the rows are
+        // the same as before, nothing can have been inserted, deleted or
+        // modified and the diff can be skipped. The rows still have to be
+        // compared as the query can depend on tables which aren't tracked,
+        // such as ones linking to the query's table via a backlink condition.
+        auto rows_unchanged = [&] {
+            if (m_previous_rows.size() != m_tv.size())
+                return false;
+            for (size_t i = 0; i < m_tv.size(); ++i) {
+                if (m_previous_rows[i] != m_tv[i].get_index())
+                    return false;
+            }
+            return true;
+        };
+        if (m_modifications_tracked && m_query->produces_results_in_table_order()
+            && (!changes || changes->empty()) && !related_table_modified(*m_info)
+            && rows_unchanged()) {
+            m_changes = {};
+            return;
+        }
+
+        if (changes && calculate_changes_incrementally(*changes))
+            return;
+
         std::vector<size_t> next_rows;
         next_rows.reserve(m_tv.size());
         for (size_t i = 0; i < m_tv.size(); ++i)
@@ -129,9 +193,21 @@ void ResultsNotifier::calculate_changes()
                 move_candidates = changes->insertions;
         }
 
+        bool cancelled = false;
         m_changes = CollectionChangeBuilder::calculate(m_previous_rows, next_rows,
                                                        get_modification_checker(*m_info, *m_query->get_table()),
-                                                       move_candidates);
+                                                       move_candidates,
+                                                       [&] { return cancelled || (cancelled = is_abandoned()); },
+                                                       m_max_diff_rows);
+        if (cancelled) {
+            // m_previous_rows has already been updated for this transaction's
+            // moves, so just drop the rows which no longer exist to keep it
+            // valid for the next diff
+            m_previous_rows.erase(std::remove(m_previous_rows.begin(), m_previous_rows.end(), npos),
+                                  m_previous_rows.end());
+            abandon_run();
+            return;
+        }
 
         m_previous_rows = std::move(next_rows);
     }
@@ -142,22 +218,156 @@ void ResultsNotifier::calculate_changes()
     }
 }
 
+// For unsorted queries we can update the previous rows using just the rows
+// which were actually changed rather than diffing the full old and new result
+// sets, as long as the changes to the table didn't shift any of the existing
+// rows and nothing linked to was modified. This makes calculating the changes
+// for the common case of a write which modifies or appends a few rows
+// O(changes * log(N)) rather than O(N log N). The query itself is still rerun
+// in full, as the TableView handed over to the target thread can only be
+// produced by running it.
+bool ResultsNotifier::calculate_changes_incrementally(CollectionChangeBuilder const& changes)
+{
+    if (!m_target_is_in_table_order || m_sort || m_distinct || !m_modifications_tracked)
+        return false;
+    if (!changes.moves.empty())
+        return false;
+
+    auto& table = *m_query->get_table();
+    size_t table_ndx = table.get_index_in_group();
+    // Modifications to linked rows can change whether any row matches the
+    // query or is reported as modified, so every row needs to be checked
+    if (related_table_modified(*m_info, table_ndx))
+        return false;
+
+    // Each changed row is checked individually, which is only a win if there
+    // aren't very many of them
+    size_t changed_rows = changes.insertions.count() + changes.modifications.count();
+    if (changed_rows > std::max<size_t>(m_previous_rows.size() / 2, 64))
+        return false;
+
+    // Rows before the first inserted or deleted row keep the same index, so
+    // everything after that point in the previous results must have been
+    // deleted for the previous row indices to still be valid
+    size_t first_changed = npos;
+    if (!changes.deletions.empty())
+        first_changed = changes.deletions.begin()->first;
+    if (!changes.insertions.empty())
+        first_changed = std::min(first_changed, changes.insertions.begin()->first);
+    auto tail = std::lower_bound(m_previous_rows.begin(), m_previous_rows.end(), first_changed);
+    if (!std::all_of(tail, m_previous_rows.end(), [&](size_t row) { return changes.deletions.contains(row); }))
+        return false;
+
+    CollectionChangeBuilder result;
+    size_t tail_begin = tail - m_previous_rows.begin();
+    for (size_t i = tail_begin; i < m_previous_rows.size(); ++i)
+        result.deletions.add(i);
+
+    auto row_did_change = get_modification_checker(*m_info, table);
+    std::vector<size_t> added_rows, modified_rows;
+    auto check_row = [&](size_t row) {
+        auto it = std::lower_bound(m_previous_rows.begin(), tail, row);
+        bool was_present = it != tail && *it == row;
+        bool is_present = m_query->count(row, row + 1, 1) != 0;
+        if (was_present && !is_present)
+            result.deletions.add(it - m_previous_rows.begin());
+        else if (!was_present && is_present)
+            added_rows.push_back(row);
+        else if (was_present && row_did_change(row))
+            modified_rows.push_back(row);
+    };
+    for (auto row : changes.insertions.as_indexes())
+        check_row(row);
+    for (auto row : changes.modifications.as_indexes()) {
+        if (!changes.insertions.contains(row))
+            check_row(row);
+    }
+
+    // Splice the rows which started matching in among the previous rows
+    // which still match
+    std::sort(added_rows.begin(), added_rows.end());
+    std::vector<size_t> next_rows;
+    next_rows.reserve(tail_begin + added_rows.size());
+    auto removed = result.deletions.begin();
+    auto added = added_rows.begin();
+    for (size_t i = 0; i < tail_begin; ++i) {
+        while (removed != result.deletions.end() && removed->second <= i)
+            ++removed;
+        if (removed != result.deletions.end() && removed->first <= i)
+            continue;
+        for (; added != added_rows.end() && *added < m_previous_rows[i]; ++added)
+            next_rows.push_back(*added);
+        next_rows.push_back(m_previous_rows[i]);
+    }
+    next_rows.insert(next_rows.end(), added, added_rows.end());
+
+    // The change info only covers the query's table and the tables it links
+    // to, but a query can also depend on other tables, such as via a backlink
+    // count. Such changes aren't visible here, so confirm that the result
+    // matches the rerun query and fall back to the full diff if it doesn't.
+    // This is a linear scan, but is still far cheaper than the full diff.
+    if (next_rows.size() != m_tv.size())
+        return false;
+    for (size_t i = 0; i < next_rows.size(); ++i) {
+        if (next_rows[i] != m_tv[i].get_index())
+            return false;
+    }
+    m_previous_rows = std::move(next_rows);
+
+    auto position_of = [&](size_t row) {
+        return std::lower_bound(m_previous_rows.begin(), m_previous_rows.end(), row) - m_previous_rows.begin();
+    };
+    for (auto row : added_rows)
+        result.insertions.add(position_of(row));
+    for (auto row : modified_rows)
+        result.modifications.add(position_of(row));
+
+    m_changes = std::move(result);
+    m_last_run_incremental = true;
+    return true;
+}
+
 void ResultsNotifier::run()
 {
+    m_last_run_incremental = false;
     if (!need_to_run())
         return;
 
     m_query->sync_view_if_needed();
     m_tv = m_query->find_all();
     if (m_sort) {
+        if (is_abandoned())
+            return abandon_run();
         m_tv.sort(m_sort);
     }
     if (m_distinct) {
+        if (is_abandoned())
+            return abandon_run();
         m_tv.distinct(m_distinct);
     }
+    if (is_abandoned())
+        return abandon_run();
+    m_last_seen_version = m_tv.sync_if_needed();
+
+    calculate_changes();
+}
+
+bool ResultsNotifier::run_from(CollectionNotifier& source)
+{
+    auto& other = static_cast<ResultsNotifier&>(source);
+    if (!other.m_tv.is_attached() || !other.m_tv.is_in_sync())
+        return false;
+    m_last_run_incremental = false;
+    if (!need_to_run())
+        return true;
+
+    // Copying the other notifier's TableView just copies the row indices
+    // rather than rerunning the query, sort and distinct
+    m_tv = other.m_tv;
     m_last_seen_version = m_tv.sync_if_needed();
 
     calculate_changes();
+    return true;
 }
 
 void ResultsNotifier::do_prepare_handover(SharedGroup& sg)
@@ -46,6 +46,8 @@ private:
     SortDescriptor::HandoverPatch m_distinct_handover;
     SortDescriptor m_distinct;
     bool m_target_is_in_table_order;
+    // Realm::Config::async_notifier_max_diff_rows, or npos if unlimited
+    size_t m_max_diff_rows;
 
     // The TableView resulting from running the query. Will be detached unless
     // the query was (re)run since the last time the handover object was created
@@ -64,14 +66,33 @@ private:
     CollectionChangeBuilder m_changes;
     TransactionChangeInfo* m_info = nullptr;
 
+    // Whether m_info is tracking modifications for the query's table and all
+    // of the tables linked to from it, which is only the case if the changes
+    // are actually going to be delivered to someone
+    bool m_modifications_tracked = false;
+
+    // Whether the changes from the last run were calculated by
+    // calculate_changes_incrementally() rather than the full diff
+    bool m_last_run_incremental = false;
+
     bool need_to_run();
+    // Check if the results are no longer going to be used by anything, in
+    // which case any work in progress for them can be abandoned
+    bool is_abandoned();
+    void abandon_run();
     void calculate_changes();
+    bool calculate_changes_incrementally(CollectionChangeBuilder const& changes);
     void deliver(SharedGroup&) override;
 
     void run() override;
+    bool run_from(CollectionNotifier& source) override;
     void do_prepare_handover(SharedGroup&) override;
     bool do_add_required_change_info(TransactionChangeInfo& info) override;
     bool prepare_to_deliver() override;
+    // The query can depend on properties of linked objects which aren't
+    // observed by any of the callbacks
+    bool needs_all_related_tables() const noexcept override { return true; }
+    bool last_run_was_incremental() const noexcept override { return m_last_run_incremental; }
 
     void release_data() noexcept override;
     void do_attach_to(SharedGroup& sg) override;
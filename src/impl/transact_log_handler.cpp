@@ -87,9 +87,13 @@ KVOAdapter::KVOAdapter(std::vector<BindingContext::ObserverState>& observers, Bi
         table_modifications_needed.resize(*max + 1, false);
     if (*max >= table_moves_needed.size())
         table_moves_needed.resize(*max + 1, false);
+    // Observers are told which columns of their row changed
+    if (*max >= table_columns_needed.size())
+        table_columns_needed.resize(*max + 1, false);
     for (auto& tbl : tables_needed) {
         table_modifications_needed[tbl] = true;
         table_moves_needed[tbl] = true;
+        table_columns_needed[tbl] = true;
     }
     for (auto& list : m_lists)
         lists.push_back({list.observer->table_ndx, list.observer->row_ndx, list.col, &list.builder});
@@ -370,7 +374,13 @@ class TransactLogObserver : public TransactLogValidationMixin, public MarkDirtyM
         if (!m_info.track_all && (tbl_ndx >= m_info.table_modifications_needed.size() || !m_info.table_modifications_needed[tbl_ndx]))
             return nullptr;
         if (m_info.tables.size() <= tbl_ndx) {
+            size_t old_size = m_info.tables.size();
             m_info.tables.resize(std::max(m_info.tables.size() * 2, tbl_ndx + 1));
+            for (size_t i = old_size; i < m_info.tables.size(); ++i) {
+                bool track_columns = m_info.track_all || (i < m_info.table_columns_needed.size()
+                                                          && m_info.table_columns_needed[i]);
+                m_info.tables[i].set_track_columns(track_columns);
+            }
         }
         return &m_info.tables[tbl_ndx];
     }
@@ -579,6 +589,7 @@ public:
         insert_empty_at(m_info.tables, ndx);
         insert_empty_at(m_info.table_moves_needed, ndx);
         insert_empty_at(m_info.table_modifications_needed, ndx);
+        insert_empty_at(m_info.table_columns_needed, ndx);
         return true;
     }
 
@@ -607,6 +618,7 @@ public:
         rotate(m_info.tables, from, to);
         rotate(m_info.table_modifications_needed, from, to);
         rotate(m_info.table_moves_needed, from, to);
+        rotate(m_info.table_columns_needed, from, to);
         return true;
     }
 
@@ -27,9 +27,102 @@ using namespace realm::_impl;
 
 const size_t IndexSet::npos;
 
+namespace {
+constexpr size_t floor_log2(size_t n) noexcept { return n <= 1 ? 0 : 1 + floor_log2(n / 2); }
+
+// Buffers of 2^n ranges are cached for each n from zero up to a full chunk
+const size_t bucket_count = floor_log2(ChunkedRangeVector::max_size) + 1;
+// The maximum number of free buffers cached for each size
+const size_t max_cached_buffers = 32;
+
+struct BufferCache {
+    void* buffers[bucket_count][max_cached_buffers];
+    size_t cached[bucket_count] = {};
+    ChunkBufferPool::Stats stats;
+
+    ~BufferCache()
+    {
+        for (size_t i = 0; i < bucket_count; ++i) {
+            for (size_t j = 0; j < cached[i]; ++j)
+                ::operator delete(buffers[i][j]);
+        }
+    }
+};
+
+// The cache is destroyed when the thread exits, which may be before other
+// thread-local or static objects which own chunks are destroyed, so it's
+// accessed through a trivially-destructible pointer which is cleared at that
+// point and buffers are then freed directly.
+thread_local BufferCache* t_cache = nullptr;
+thread_local bool t_cache_destroyed = false;
+
+struct BufferCacheOwner {
+    BufferCache cache;
+
+    BufferCacheOwner() noexcept { t_cache = &cache; }
+    ~BufferCacheOwner()
+    {
+        t_cache = nullptr;
+        t_cache_destroyed = true;
+    }
+};
+
+BufferCache* get_cache() noexcept
+{
+    if (!t_cache && !t_cache_destroyed) {
+        static thread_local BufferCacheOwner owner;
+        static_cast<void>(owner);
+    }
+    return t_cache;
+}
+
+// Get the cache bucket for buffers of the given size in bytes, or
+// bucket_count if buffers of that size aren't cached
+size_t bucket_for(size_t size) noexcept
+{
+    const size_t range_size = sizeof(ChunkedRangeVector::value_type);
+    size_t n = size / range_size;
+    if (n == 0 || n * range_size != size || (n & (n - 1)) != 0)
+        return bucket_count;
+    return std::min<size_t>(bitmap::count_trailing_zeros(n), bucket_count);
+}
+} // anonymous namespace
+
+void* ChunkBufferPool::allocate(size_t size)
+{
+    if (auto cache = get_cache()) {
+        ++cache->stats.allocations;
+        size_t bucket = bucket_for(size);
+        if (bucket < bucket_count && cache->cached[bucket]) {
+            ++cache->stats.reused;
+            return cache->buffers[bucket][--cache->cached[bucket]];
+        }
+    }
+    return ::operator new(size);
+}
+
+void ChunkBufferPool::deallocate(void* ptr, size_t size) noexcept
+{
+    if (auto cache = get_cache()) {
+        size_t bucket = bucket_for(size);
+        if (bucket < bucket_count && cache->cached[bucket] < max_cached_buffers) {
+            cache->buffers[bucket][cache->cached[bucket]++] = ptr;
+            return;
+        }
+    }
+    ::operator delete(ptr);
+}
+
+ChunkBufferPool::Stats ChunkBufferPool::stats() noexcept
+{
+    auto cache = get_cache();
+    return cache ? cache->stats : Stats();
+}
+
 template<typename T>
 void MutableChunkedRangeVectorIterator<T>::set(size_t front, size_t back)
 {
+    REALM_ASSERT_DEBUG(this->m_inner);
     this->m_outer->count -= this->m_inner->second - this->m_inner->first;
     if (this->offset() == 0) {
         this->m_outer->begin = front;
@@ -45,6 +138,7 @@ void MutableChunkedRangeVectorIterator<T>::set(size_t front, size_t back)
 template<typename T>
 void MutableChunkedRangeVectorIterator<T>::adjust(ptrdiff_t front, ptrdiff_t back)
 {
+    REALM_ASSERT_DEBUG(this->m_inner);
     if (this->offset() == 0) {
         this->m_outer->begin += front;
     }
@@ -59,6 +153,7 @@ void MutableChunkedRangeVectorIterator<T>::adjust(ptrdiff_t front, ptrdiff_t bac
 template<typename T>
 void MutableChunkedRangeVectorIterator<T>::shift(ptrdiff_t distance)
 {
+    REALM_ASSERT_DEBUG(this->m_inner);
     if (this->offset() == 0) {
         this->m_outer->begin += distance;
     }
@@ -71,7 +166,7 @@ void MutableChunkedRangeVectorIterator<T>::shift(ptrdiff_t distance)
 
 void ChunkedRangeVector::push_back(value_type value)
 {
-    if (!empty() && m_data.back().data.size() < max_size) {
+    if (!empty() && !m_data.back().packed() && m_data.back().data.size() < max_size) {
         auto& range = m_data.back();
         REALM_ASSERT(range.end <= value.first);
 
@@ -80,7 +175,8 @@ void ChunkedRangeVector::push_back(value_type value)
         range.end = value.second;
     }
     else {
-        m_data.push_back({{std::move(value)}, value.first, value.second, value.second - value.first});
+        size_t count_before = empty() ? 0 : m_data.back().count_before + m_data.back().count;
+        m_data.push_back({{std::move(value)}, value.first, value.second, value.second - value.first, count_before});
     }
     verify();
 }
@@ -91,6 +187,7 @@ ChunkedRangeVector::iterator ChunkedRangeVector::insert(iterator pos, value_type
         push_back(std::move(value));
         return std::prev(end());
     }
+    REALM_ASSERT_DEBUG(!pos.m_outer->packed());
 
     pos = ensure_space(pos);
     auto& chunk = *pos.m_outer;
@@ -180,6 +277,19 @@ void ChunkedRangeVector::verify() const noexcept
     }
 
     for (auto& chunk : m_data) {
+        if (chunk.packed()) {
+            REALM_ASSERT(m_packed);
+            REALM_ASSERT(chunk.data.empty());
+            REALM_ASSERT(chunk.bits.size() == (chunk.end - chunk.begin + 63) / 64);
+            REALM_ASSERT(bitmap::find_next(chunk.bits, 0, chunk.end - chunk.begin, true) == 0);
+            REALM_ASSERT(bitmap::find_prev(chunk.bits, chunk.bits.size() * 64, true) == chunk.end - chunk.begin - 1);
+            size_t count = 0;
+            for (auto word : chunk.bits)
+                count += bitmap::count_set_bits(word);
+            REALM_ASSERT(count == chunk.count);
+            continue;
+        }
+
         REALM_ASSERT(!chunk.data.empty());
         REALM_ASSERT(chunk.data.front().first == chunk.begin);
         REALM_ASSERT(chunk.data.back().second == chunk.end);
@@ -192,6 +302,56 @@ void ChunkedRangeVector::verify() const noexcept
 #endif
 }
 
+void ChunkedRangeVector::update_counts(size_t first_chunk) noexcept
+{
+    for (size_t i = first_chunk; i < m_data.size(); ++i)
+        m_data[i].count_before = i == 0 ? 0 : m_data[i - 1].count_before + m_data[i - 1].count;
+}
+
+void ChunkedRangeVector::pack()
+{
+    m_packed = false;
+    for (auto& chunk : m_data) {
+        // Only pack chunks where the bitmap would be at most a quarter of the
+        // size of the ranges, as reading and modifying ranges is cheaper
+        size_t words = (chunk.end - chunk.begin + 63) / 64;
+        if (chunk.packed())
+            m_packed = true;
+        if (chunk.packed() || words * 2 > chunk.data.size())
+            continue;
+
+        chunk.bits.assign(words, 0);
+        for (auto range : chunk.data) {
+            for (size_t i = range.first - chunk.begin; i < range.second - chunk.begin; ++i)
+                chunk.bits[i / 64] |= uint64_t(1) << i % 64;
+        }
+        decltype(chunk.data)().swap(chunk.data);
+        m_packed = true;
+    }
+    verify();
+}
+
+void ChunkedRangeVector::unpack()
+{
+    if (!m_packed)
+        return;
+
+    for (auto& chunk : m_data) {
+        if (!chunk.packed())
+            continue;
+
+        size_t size = chunk.end - chunk.begin;
+        for (size_t bit = 0; bit < size; ) {
+            size_t end = bitmap::find_next(chunk.bits, bit, size, false);
+            chunk.data.push_back({chunk.begin + bit, chunk.begin + end});
+            bit = bitmap::find_next(chunk.bits, end, size, true);
+        }
+        std::vector<uint64_t>().swap(chunk.bits);
+    }
+    m_packed = false;
+    verify();
+}
+
 namespace {
 class ChunkedRangeVectorBuilder {
 public:
@@ -210,7 +370,7 @@ ChunkedRangeVectorBuilder::ChunkedRangeVectorBuilder(ChunkedRangeVector const& e
 {
     size_t size = 0;
     for (auto const& chunk : expected.m_data)
-        size += chunk.data.size();
+        size += chunk.packed() ? chunk.count : chunk.data.size();
     m_data.resize(size / ChunkedRangeVector::max_size + 1);
     for (size_t i = 0; i < m_data.size() - 1; ++i)
         m_data[i].data.reserve(ChunkedRangeVector::max_size);
@@ -241,7 +401,7 @@ void ChunkedRangeVectorBuilder::push_back(std::pair<size_t, size_t> range)
         chunk.end = chunk.data.back().second;
         ++m_outer_pos;
         if (m_outer_pos >= m_data.size())
-            m_data.push_back({{range}, range.first, 0, 1});
+            m_data.push_back({{range}, range.first, 0, range.second - range.first});
         else {
             auto& chunk = m_data[m_outer_pos];
             chunk.data.push_back(range);
@@ -260,6 +420,8 @@ std::vector<ChunkedRangeVector::Chunk> ChunkedRangeVectorBuilder::finalize()
         else
             m_data.back().end = m_data.back().data.back().second;
     }
+    for (size_t i = 1; i < m_data.size(); ++i)
+        m_data[i].count_before = m_data[i - 1].count_before + m_data[i - 1].count;
     return std::move(m_data);
 }
 }
@@ -278,46 +440,75 @@ bool IndexSet::contains(size_t index) const noexcept
 
 size_t IndexSet::count(size_t start_index, size_t end_index) const noexcept
 {
-    auto it = const_cast<IndexSet*>(this)->find(start_index);
-    const auto end = this->end();
-    if (it == end || it->first >= end_index) {
+    if (start_index >= end_index)
         return 0;
-    }
-    if (it->second >= end_index)
-        return std::min(it->second, end_index) - std::max(it->first, start_index);
+    return count_less_than(end_index) - count_less_than(start_index);
+}
+
+size_t IndexSet::count_less_than(size_t index) const noexcept
+{
+    auto it = const_cast<IndexSet*>(this)->find(index);
+    if (it == end())
+        return empty() ? 0 : m_data.back().count_before + m_data.back().count;
+
+    auto& chunk = *it.outer();
+    size_t ret = chunk.count_before;
+    if (index <= chunk.begin)
+        return ret;
+
+    if (chunk.packed()) {
+        size_t bit = index - chunk.begin;
+        for (size_t i = 0; i < bit / 64; ++i)
+            ret += bitmap::count_set_bits(chunk.bits[i]);
+        if (bit % 64)
+            ret += bitmap::count_set_bits(chunk.bits[bit / 64] & (~uint64_t(0) >> (64 - bit % 64)));
+        return ret;
+    }
+
+    for (auto range = chunk.data.data(), end = range + it.offset(); range != end; ++range)
+        ret += range->second - range->first;
+    if (it->first < index)
+        ret += index - it->first;
+    return ret;
+}
 
-    size_t ret = 0;
+size_t IndexSet::nth(size_t n) const noexcept
+{
+    auto chunk = std::partition_point(m_data.begin(), m_data.end(), [&](auto const& c) {
+        return c.count_before + c.count <= n;
+    });
+    if (chunk == m_data.end())
+        return npos;
 
-    if (start_index > it->first || it.offset() != 0) {
-        // Start index is in the middle of a chunk, so start by counting the
-        // rest of that chunk
-        ret = it->second - std::max(it->first, start_index);
-        for (++it; it != end && it->second < end_index && it.offset() != 0; ++it) {
-            ret += it->second - it->first;
-        }
-        if (it != end && it->first < end_index && it.offset() != 0)
-            ret += end_index - it->first;
-        if (it == end || it->second >= end_index)
-            return ret;
+    n -= chunk->count_before;
+    for (const_iterator it(chunk, m_data.end(), chunk->data.data()); ; ++it) {
+        if (n < it->second - it->first)
+            return it->first + n;
+        n -= it->second - it->first;
     }
+}
 
-    // Now count all complete chunks that fall within the range
-    while (it != end && it.outer()->end <= end_index) {
-        REALM_ASSERT_DEBUG(it.offset() == 0);
-        ret += it.outer()->count;
-        it.next_chunk();
-    }
+void IndexSet::update_counts_from(size_t index) noexcept
+{
+    // Chunks which end before the index were not modified, other than
+    // possibly the last of them if its last range was removed
+    auto it = std::partition_point(m_data.begin(), m_data.end(), [&](auto const& c) {
+        return c.end < index;
+    });
+    size_t first = it - m_data.begin();
+    update_counts(first ? first - 1 : 0);
+}
 
-    // Cound all complete ranges within the last chunk
-    while (it != end && it->second <= end_index) {
-        ret += it->second - it->first;
-        ++it;
+void IndexSet::verify() const noexcept
+{
+#ifdef REALM_DEBUG
+    ChunkedRangeVector::verify();
+    size_t count = 0;
+    for (auto& chunk : m_data) {
+        REALM_ASSERT(chunk.count_before == count);
+        count += chunk.count;
     }
-
-    // And finally add in the partial last range
-    if (it != end && it->first < end_index)
-        ret += end_index - it->first;
-    return ret;
+#endif
 }
 
 IndexSet::iterator IndexSet::find(size_t index) noexcept
@@ -327,12 +518,12 @@ IndexSet::iterator IndexSet::find(size_t index) noexcept
 
 IndexSet::iterator IndexSet::find(size_t index, iterator begin) noexcept
 {
-    auto it = std::find_if(begin.outer(), m_data.end(),
-                           [&](auto const& lft) { return lft.end > index; });
+    auto it = std::partition_point(begin.outer(), m_data.end(),
+                                   [&](auto const& lft) { return lft.end <= index; });
     if (it == m_data.end())
         return end();
-    if (index < it->begin)
-        return iterator(it, m_data.end(), &it->data[0]);
+    if (index < it->begin || it->packed())
+        return iterator(it, m_data.end(), it->data.data(), index < it->begin ? 0 : index - it->begin);
     auto inner_begin = it->data.begin();
     if (it == begin.outer())
         inner_begin += begin.offset();
@@ -345,19 +536,69 @@ IndexSet::iterator IndexSet::find(size_t index, iterator begin) noexcept
 
 void IndexSet::add(size_t index)
 {
+    // Indices are usually added in ascending order, so adding after the end
+    // of the set appends to the last chunk without searching for the position
+    if (empty() || index > m_data.back().end) {
+        push_back({index, index + 1});
+        return;
+    }
+    auto& last = m_data.back();
+    if (index == last.end && !last.packed()) {
+        ++last.data.back().second;
+        ++last.end;
+        ++last.count;
+        return;
+    }
+
+    unpack();
     do_add(find(index), index);
+    update_counts_from(index);
 }
 
 void IndexSet::add(IndexSet const& other)
 {
-    auto it = begin();
-    for (size_t index : other.as_indexes()) {
-        it = do_add(find(index, it), index);
+    if (other.empty())
+        return;
+    if (empty()) {
+        *this = other;
+        return;
+    }
+
+    // Adding each index costs up to a chunk's worth of work, so only do that
+    // if it's less work than rebuilding the set
+    if (other.count() < m_data.size()) {
+        unpack();
+        auto it = begin();
+        for (size_t index : other.as_indexes()) {
+            it = do_add(find(index, it), index);
+        }
+        update_counts_from(other.begin()->first);
+        return;
+    }
+
+    ChunkedRangeVectorBuilder builder(*this);
+    auto it1 = cbegin(), end1 = cend();
+    auto it2 = other.cbegin(), end2 = other.cend();
+    value_type pending = it1->first < it2->first ? *it1++ : *it2++;
+    while (it1 != end1 || it2 != end2) {
+        value_type next = it2 == end2 || (it1 != end1 && it1->first < it2->first) ? *it1++ : *it2++;
+        if (next.first <= pending.second) {
+            pending.second = std::max(pending.second, next.second);
+        }
+        else {
+            builder.push_back(pending);
+            pending = next;
+        }
     }
+    builder.push_back(pending);
+
+    m_data = builder.finalize();
+    pack();
 }
 
 size_t IndexSet::add_shifted(size_t index)
 {
+    unpack();
     iterator it = begin(), end = this->end();
 
     // Shift for any complete chunks before the target
@@ -369,6 +610,7 @@ size_t IndexSet::add_shifted(size_t index)
         index += it->second - it->first;
 
     do_add(it, index);
+    update_counts_from(index);
     return index;
 }
 
@@ -413,6 +655,7 @@ void IndexSet::add_shifted_by(IndexSet const& shifted_by, IndexSet const& values
 
     copy(old_it, old_end, std::back_inserter(builder));
     m_data = builder.finalize();
+    pack();
 
 #ifdef REALM_DEBUG
     REALM_ASSERT((size_t)std::distance(as_indexes().begin(), as_indexes().end()) == expected);
@@ -429,6 +672,7 @@ void IndexSet::set(size_t len)
 
 void IndexSet::insert_at(size_t index, size_t count)
 {
+    unpack();
     REALM_ASSERT(count > 0);
 
     auto pos = find(index);
@@ -450,6 +694,7 @@ void IndexSet::insert_at(size_t index, size_t count)
             pos = std::next(do_add(pos, index + i));
     }
 
+    update_counts_from(index);
     verify();
 }
 
@@ -482,10 +727,12 @@ void IndexSet::insert_at(IndexSet const& positions)
         builder.push_back(*begin2);
 
     m_data = builder.finalize();
+    pack();
 }
 
 void IndexSet::shift_for_insert_at(size_t index, size_t count)
 {
+    unpack();
     REALM_ASSERT(count > 0);
 
     auto it = find(index);
@@ -502,6 +749,7 @@ void IndexSet::shift_for_insert_at(size_t index, size_t count)
         it.set(it->first - count, index);
         insert(std::next(it), {index + count, old_second});
     }
+    update_counts_from(index);
     verify();
 }
 
@@ -530,13 +778,17 @@ void IndexSet::shift_for_insert_at(realm::IndexSet const& values)
         builder.push_back(*begin1 + shift);
 
     m_data = builder.finalize();
+    pack();
 }
 
 void IndexSet::erase_at(size_t index)
 {
+    unpack();
     auto it = find(index);
-    if (it != end())
+    if (it != end()) {
         do_erase(it, index);
+        update_counts_from(index);
+    }
 }
 
 void IndexSet::erase_at(IndexSet const& positions)
@@ -568,29 +820,19 @@ void IndexSet::erase_at(IndexSet const& positions)
         builder.push_back(*begin1 - shift);
 
     m_data = builder.finalize();
+    pack();
 }
 
 size_t IndexSet::erase_or_unshift(size_t index)
 {
-    auto shifted = index;
-    iterator it = begin(), end = this->end();
-
-    // Shift for any complete chunks before the target
-    for (; it != end && it.outer()->end <= index; it.next_chunk())
-        shifted -= it.outer()->count;
-
-    // And any ranges within the last partial chunk
-    for (; it != end && it->second <= index; ++it)
-        shifted -= it->second - it->first;
-
-    if (it == end)
+    unpack();
+    auto it = find(index);
+    size_t shifted = it != end() && it->first <= index ? npos : index - count_less_than(index);
+    if (it == end())
         return shifted;
 
-    if (it->first <= index)
-        shifted = npos;
-
     do_erase(it, index);
-
+    update_counts_from(index);
     return shifted;
 }
 
@@ -640,26 +882,67 @@ IndexSet::iterator IndexSet::do_remove(iterator it, size_t begin, size_t end)
 
 void IndexSet::remove(size_t index, size_t count)
 {
+    unpack();
     do_remove(find(index), index, index + count);
+    update_counts_from(index);
 }
 
 void IndexSet::remove(realm::IndexSet const& values)
 {
-    auto it = begin();
-    for (auto range : values) {
-        it = do_remove(it, range.first, range.second);
-        if (it == end())
-            return;
+    if (empty() || values.empty())
+        return;
+
+    // As with add(), remove each range individually if that's less work than
+    // rebuilding the set
+    if (values.count() < m_data.size()) {
+        unpack();
+        auto it = begin();
+        for (auto range : values) {
+            it = do_remove(it, range.first, range.second);
+            if (it == end())
+                break;
+        }
+        update_counts_from(values.begin()->first);
+        return;
     }
+
+    ChunkedRangeVectorBuilder builder(*this);
+    auto remove_it = values.cbegin(), remove_end = values.cend();
+    for (auto it = cbegin(), end = cend(); it != end; ++it) {
+        auto range = *it;
+        for (; remove_it != remove_end && remove_it->second <= range.first; ++remove_it)
+            ;
+        // Copy the parts of the range between the ranges being removed
+        for (auto remove = remove_it; remove != remove_end && remove->first < range.second; ++remove) {
+            if (remove->first > range.first)
+                builder.push_back({range.first, remove->first});
+            range.first = std::max(range.first, remove->second);
+        }
+        if (range.first < range.second)
+            builder.push_back(range);
+    }
+
+    m_data = builder.finalize();
+    pack();
 }
 
 size_t IndexSet::shift(size_t index) const noexcept
 {
-    // FIXME: optimize
-    for (auto range : *this) {
-        if (range.first > index)
+    // Find the first chunk which begins after the index once it's been shifted
+    // by all of the chunks before it, and then shift by the ranges in the
+    // chunk before that one
+    auto chunk = std::partition_point(m_data.begin(), m_data.end(), [&](auto const& c) {
+        return c.begin <= index + c.count_before;
+    });
+    if (chunk == m_data.begin())
+        return index;
+    --chunk;
+
+    index += chunk->count_before;
+    for (const_iterator it(chunk, m_data.end(), chunk->data.data()); it != end() && it.outer() == chunk; ++it) {
+        if (it->first > index)
             break;
-        index += range.second - range.first;
+        index += it->second - it->first;
     }
     return index;
 }
@@ -673,11 +956,12 @@ size_t IndexSet::unshift(size_t index) const noexcept
 void IndexSet::clear() noexcept
 {
     m_data.clear();
+    m_packed = false;
 }
 
 IndexSet::iterator IndexSet::do_add(iterator it, size_t index)
 {
-    verify();
+    ChunkedRangeVector::verify();
     bool more_before = it != begin(), valid = it != end();
     REALM_ASSERT(!more_before || index >= std::prev(it)->second);
     if (valid && it->first <= index && it->second > index) {
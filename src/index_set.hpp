@@ -19,7 +19,9 @@
 #ifndef REALM_INDEX_SET_HPP
 #define REALM_INDEX_SET_HPP
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <initializer_list>
 #include <iterator>
 #include <type_traits>
@@ -28,24 +30,118 @@
 
 namespace realm {
 namespace _impl {
+namespace bitmap {
+inline unsigned count_trailing_zeros(uint64_t value) noexcept
+{
+#if __GNUC__ || __clang__
+    return __builtin_ctzll(value);
+#else
+    unsigned count = 0;
+    for (; !(value & 1); value >>= 1)
+        ++count;
+    return count;
+#endif
+}
+
+inline unsigned count_set_bits(uint64_t value) noexcept
+{
+#if __GNUC__ || __clang__
+    return __builtin_popcountll(value);
+#else
+    unsigned count = 0;
+    for (; value; value &= value - 1)
+        ++count;
+    return count;
+#endif
+}
+
+inline unsigned count_leading_zeros(uint64_t value) noexcept
+{
+#if __GNUC__ || __clang__
+    return __builtin_clzll(value);
+#else
+    unsigned count = 0;
+    for (; !(value & (uint64_t(1) << 63)); value <<= 1)
+        ++count;
+    return count;
+#endif
+}
+
+// Find the first bit at or after `pos` which is equal to `value`, or `size`
+// if there are none before that
+inline size_t find_next(std::vector<uint64_t> const& bits, size_t pos, size_t size, bool value) noexcept
+{
+    size_t word = pos / 64;
+    if (word >= bits.size())
+        return size;
+    uint64_t current = (value ? bits[word] : ~bits[word]) & (~uint64_t(0) << pos % 64);
+    while (!current) {
+        if (++word == bits.size())
+            return size;
+        current = value ? bits[word] : ~bits[word];
+    }
+    return std::min<size_t>(word * 64 + count_trailing_zeros(current), size);
+}
+
+// Find the last bit before `pos` which is equal to `value`, or size_t(-1) if
+// there are none
+inline size_t find_prev(std::vector<uint64_t> const& bits, size_t pos, bool value) noexcept
+{
+    if (pos == 0)
+        return -1;
+    size_t word = (pos - 1) / 64;
+    uint64_t current = (value ? bits[word] : ~bits[word]) & (~uint64_t(0) >> (63 - (pos - 1) % 64));
+    while (!current) {
+        if (word-- == 0)
+            return -1;
+        current = value ? bits[word] : ~bits[word];
+    }
+    return word * 64 + 63 - count_leading_zeros(current);
+}
+} // namespace bitmap
+
 template<typename OuterIterator>
 class MutableChunkedRangeVectorIterator;
 
 // An iterator for ChunkedRangeVector, templated on the vector iterator/const_iterator
+//
+// Ranges in chunks which are stored as a bitmap are decoded as the iterator
+// advances, so there's no stored range for a reference to refer to. Instead,
+// like std::vector<bool>::iterator, this is a proxy iterator which returns
+// each range by value, and operator-> returns an object holding a copy of it.
+// This means that the iterator can safely be used with std::reverse_iterator
+// and that values read from it remain valid after it's modified.
 template<typename OuterIterator>
 class ChunkedRangeVectorIterator {
+    // The range type as stored in the chunks, which is const for const iterators
+    using stored_type = typename std::remove_reference<decltype(*OuterIterator()->data.begin())>::type;
+
 public:
     using iterator_category = std::bidirectional_iterator_tag;
-    using value_type = typename std::remove_reference<decltype(*OuterIterator()->data.begin())>::type;
+    using value_type = typename std::remove_const<stored_type>::type;
     using difference_type = ptrdiff_t;
-    using pointer = const value_type*;
-    using reference = const value_type&;
+    using reference = value_type;
 
-    ChunkedRangeVectorIterator(OuterIterator outer, OuterIterator end, value_type* inner)
-    : m_outer(outer), m_end(end), m_inner(inner) { }
+    class pointer {
+    public:
+        value_type const* operator->() const noexcept { return &m_value; }
+    private:
+        value_type m_value;
+        pointer(value_type value) : m_value(value) { }
+        friend class ChunkedRangeVectorIterator;
+    };
+
+    // If the chunk pointed to by `outer` is a bitmap, `inner` is ignored and
+    // the iterator points to the range containing or following `bit`
+    ChunkedRangeVectorIterator(OuterIterator outer, OuterIterator end, stored_type* inner, size_t bit=0)
+    : m_outer(outer), m_end(end), m_inner(inner)
+    {
+        if (m_outer != m_end && m_outer->packed())
+            seek(bit);
+    }
 
-    reference operator*() const noexcept { return *m_inner; }
-    pointer operator->() const noexcept { return m_inner; }
+    reference operator*() const noexcept { return m_inner ? *m_inner : m_range; }
+    pointer operator->() const noexcept { return **this; }
 
     template<typename Other> bool operator==(Other const& it) const noexcept;
     template<typename Other> bool operator!=(Other const& it) const noexcept;
@@ -60,14 +156,25 @@ public:
     void next_chunk() noexcept;
 
     OuterIterator outer() const noexcept { return m_outer; }
-    size_t offset() const noexcept { return m_inner - &m_outer->data[0]; }
+    // The position within the current chunk; zero only for the first range in it
+    size_t offset() const noexcept { return m_inner ? m_inner - &m_outer->data[0] : m_bit; }
 
 private:
     OuterIterator m_outer;
     OuterIterator m_end;
-    value_type* m_inner;
+    // The current range if the chunk stores ranges, and null otherwise
+    stored_type* m_inner;
+    // The current range and its offset from the beginning of the chunk if the
+    // chunk is a bitmap
+    std::pair<size_t, size_t> m_range = {0, 0};
+    size_t m_bit = 0;
+
+    void seek(size_t bit) noexcept;
+    void load_range(size_t bit) noexcept;
+
     friend struct ChunkedRangeVector;
     friend class MutableChunkedRangeVectorIterator<OuterIterator>;
+    template<typename> friend class ChunkedRangeVectorIterator;
 };
 
 // A mutable iterator that adds some invariant-preserving mutation methods
@@ -85,15 +192,70 @@ public:
     void shift(ptrdiff_t distance);
 };
 
+// A per-thread cache of the buffers used to store the ranges in chunks
+//
+// Calculating changes creates and destroys a large number of short-lived
+// index sets, so rather than returning chunk buffers to the system allocator
+// each thread keeps a limited number of free buffers of each power-of-two size
+// up to a full chunk for later allocations of that size to reuse. Buffers
+// freed on a different thread from the one which allocated them are added to
+// the freeing thread's cache.
+struct ChunkBufferPool {
+    struct Stats {
+        // The number of buffers which have been requested from the pool
+        size_t allocations = 0;
+        // The number of those requests which were satisfied from the cache
+        size_t reused = 0;
+    };
+
+    static void* allocate(size_t size);
+    static void deallocate(void* ptr, size_t size) noexcept;
+
+    // Get the statistics for the calling thread. These are never reset, so
+    // measuring a specific piece of work such as a notifier cycle requires
+    // comparing the values from before and after it.
+    static Stats stats() noexcept;
+};
+
+template<typename T>
+struct ChunkBufferAllocator {
+    using value_type = T;
+
+    ChunkBufferAllocator() noexcept = default;
+    template<typename U>
+    ChunkBufferAllocator(ChunkBufferAllocator<U> const&) noexcept { }
+
+    T* allocate(size_t n) { return static_cast<T*>(ChunkBufferPool::allocate(n * sizeof(T))); }
+    void deallocate(T* ptr, size_t n) noexcept { ChunkBufferPool::deallocate(ptr, n * sizeof(T)); }
+
+    template<typename U> bool operator==(ChunkBufferAllocator<U> const&) const noexcept { return true; }
+    template<typename U> bool operator!=(ChunkBufferAllocator<U> const&) const noexcept { return false; }
+};
+
 // A vector which stores ranges in chunks with a maximum size
+//
+// Each chunk stores either a list of ranges or, if it is smaller, a bitmap of
+// the indices between the chunk's begin and end. Bitmap chunks can be read but
+// not modified, so they must be unpacked before making any changes other than
+// replacing all of the chunks.
 struct ChunkedRangeVector {
     struct Chunk {
-        std::vector<std::pair<size_t, size_t>> data;
+        std::vector<std::pair<size_t, size_t>, ChunkBufferAllocator<std::pair<size_t, size_t>>> data;
         size_t begin;
         size_t end;
         size_t count;
+        // The total count of all of the chunks before this one. Operations
+        // which change the ranges must call update_counts() once they're done.
+        size_t count_before;
+        // Bit `i` is set if `begin + i` is in the chunk. Empty unless the
+        // chunk is stored as a bitmap, in which case `data` is empty.
+        std::vector<uint64_t> bits;
+
+        bool packed() const noexcept { return !bits.empty(); }
     };
     std::vector<Chunk> m_data;
+    // Whether any of the chunks are currently stored as bitmaps
+    bool m_packed = false;
 
     using value_type = std::pair<size_t, size_t>;
     using iterator = MutableChunkedRangeVectorIterator<typename decltype(m_data)::iterator>;
@@ -105,11 +267,11 @@ struct ChunkedRangeVector {
     static const size_t max_size = 4096 / sizeof(std::pair<size_t, size_t>);
 #endif
 
-    iterator begin() noexcept { return empty() ? end() : iterator(m_data.begin(), m_data.end(), &m_data[0].data[0]); }
+    iterator begin() noexcept { return empty() ? end() : iterator(m_data.begin(), m_data.end(), m_data[0].data.data()); }
     iterator end() noexcept { return iterator(m_data.end(), m_data.end(), nullptr); }
     const_iterator begin() const noexcept { return cbegin(); }
     const_iterator end() const noexcept { return cend(); }
-    const_iterator cbegin() const noexcept { return empty() ? cend() : const_iterator(m_data.cbegin(), m_data.end(), &m_data[0].data[0]); }
+    const_iterator cbegin() const noexcept { return empty() ? cend() : const_iterator(m_data.cbegin(), m_data.end(), m_data[0].data.data()); }
     const_iterator cend() const noexcept { return const_iterator(m_data.end(), m_data.end(), nullptr); }
 
     bool empty() const noexcept { return m_data.empty(); }
@@ -119,6 +281,14 @@ struct ChunkedRangeVector {
     void push_back(value_type value);
     iterator ensure_space(iterator pos);
 
+    // Recalculate count_before for each chunk starting from the given one
+    void update_counts(size_t first_chunk=0) noexcept;
+
+    // Convert the chunks which would use much less memory as a bitmap
+    void pack();
+    // Convert all bitmap chunks back to ranges so that they can be modified
+    void unpack();
+
     void verify() const noexcept;
 };
 } // namespace _impl
@@ -133,7 +303,6 @@ public:
     using ChunkedRangeVector::begin;
     using ChunkedRangeVector::end;
     using ChunkedRangeVector::empty;
-    using ChunkedRangeVector::verify;
 
     IndexSet() = default;
     IndexSet(std::initializer_list<size_t>);
@@ -144,6 +313,9 @@ public:
     // Counts the number of indices in the set in the given range
     size_t count(size_t start_index=0, size_t end_index=-1) const noexcept;
 
+    // Get the nth index in the set, or npos if the set has n or fewer indices
+    size_t nth(size_t n) const noexcept;
+
     // Add an index to the set, doing nothing if it's already present
     void add(size_t index);
     void add(IndexSet const& is);
@@ -188,6 +360,8 @@ public:
     // Remove all indexes from the set
     void clear() noexcept;
 
+    void verify() const noexcept;
+
     // An iterator over the individual indices in the set rather than the ranges
     class IndexIterator : public std::iterator<std::forward_iterator_tag, size_t> {
     public:
@@ -247,6 +421,12 @@ private:
     iterator do_remove(iterator it, size_t index, size_t count);
 
     void shift_until_end_by(iterator begin, ptrdiff_t shift);
+
+    // Get the number of indices in the set which are less than the given index
+    size_t count_less_than(size_t index) const noexcept;
+    // Update the cumulative counts of the chunks after modifying the ranges
+    // at or after the given index
+    void update_counts_from(size_t index) noexcept;
 };
 
 namespace util {
@@ -264,7 +444,7 @@ template<typename T>
 template<typename OtherIterator>
 inline bool ChunkedRangeVectorIterator<T>::operator==(OtherIterator const& it) const noexcept
 {
-    return m_outer == it.outer() && m_inner == it.operator->();
+    return m_outer == it.m_outer && m_inner == it.m_inner && m_bit == it.m_bit;
 }
 
 template<typename T>
@@ -277,8 +457,18 @@ inline bool ChunkedRangeVectorIterator<T>::operator!=(OtherIterator const& it) c
 template<typename T>
 inline ChunkedRangeVectorIterator<T>& ChunkedRangeVectorIterator<T>::operator++() noexcept
 {
-    ++m_inner;
-    if (offset() == m_outer->data.size())
+    if (m_inner) {
+        ++m_inner;
+        if (offset() == m_outer->data.size())
+            next_chunk();
+        return *this;
+    }
+
+    auto size = m_outer->end - m_outer->begin;
+    auto next = bitmap::find_next(m_outer->bits, m_range.second - m_outer->begin, size, true);
+    if (next < size)
+        load_range(next);
+    else
         next_chunk();
     return *this;
 }
@@ -294,12 +484,25 @@ inline ChunkedRangeVectorIterator<T> ChunkedRangeVectorIterator<T>::operator++(i
 template<typename T>
 inline ChunkedRangeVectorIterator<T>& ChunkedRangeVectorIterator<T>::operator--() noexcept
 {
-    if (!m_inner || m_inner == &m_outer->data.front()) {
-        --m_outer;
-        m_inner = &m_outer->data.back();
+    if (m_outer != m_end) {
+        if (m_inner && m_inner != &m_outer->data.front()) {
+            --m_inner;
+            return *this;
+        }
+        if (!m_inner && m_bit != 0) {
+            seek(bitmap::find_prev(m_outer->bits, m_bit, true));
+            return *this;
+        }
+    }
+
+    --m_outer;
+    if (m_outer->packed()) {
+        m_inner = nullptr;
+        seek(m_outer->end - m_outer->begin - 1);
     }
     else {
-        --m_inner;
+        m_inner = &m_outer->data.back();
+        m_bit = 0;
     }
     return *this;
 }
@@ -316,7 +519,36 @@ template<typename T>
 inline void ChunkedRangeVectorIterator<T>::next_chunk() noexcept
 {
     ++m_outer;
-    m_inner = m_outer != m_end ? &m_outer->data[0] : nullptr;
+    m_bit = 0;
+    if (m_outer == m_end)
+        m_inner = nullptr;
+    else if (m_outer->packed()) {
+        m_inner = nullptr;
+        load_range(0);
+    }
+    else
+        m_inner = &m_outer->data[0];
+}
+
+template<typename T>
+inline void ChunkedRangeVectorIterator<T>::seek(size_t bit) noexcept
+{
+    // Move back to the start of the range if the bit is in one, and otherwise
+    // forward to the start of the next one
+    if (m_outer->bits[bit / 64] & (uint64_t(1) << bit % 64))
+        load_range(bitmap::find_prev(m_outer->bits, bit, false) + 1);
+    else
+        load_range(bitmap::find_next(m_outer->bits, bit, m_outer->end - m_outer->begin, true));
+}
+
+template<typename T>
+inline void ChunkedRangeVectorIterator<T>::load_range(size_t bit) noexcept
+{
+    auto size = m_outer->end - m_outer->begin;
+    m_inner = nullptr;
+    m_bit = bit;
+    m_range.first = m_outer->begin + bit;
+    m_range.second = m_outer->begin + bitmap::find_next(m_outer->bits, bit, size, false);
 }
 } // namespace _impl
 
@@ -234,14 +234,24 @@ size_t hash<realm::List>::operator()(realm::List const& list) const
 }
 }
 
-NotificationToken List::add_notification_callback(CollectionChangeCallback cb) &
+NotificationToken List::add_notification_callback(CollectionChangeCallback cb, NotificationPriority priority) &
+{
+    return add_notification_callback(std::move(cb), {}, priority);
+}
+
+NotificationToken List::add_notification_callback(CollectionChangeCallback cb,
+                                                  std::vector<std::string> const& key_paths,
+                                                  NotificationPriority priority) &
 {
     verify_attached();
+    std::vector<_impl::DeepChangeChecker::RelatedTable> observed_tables;
+    if (!key_paths.empty())
+        _impl::DeepChangeChecker::find_related_tables(observed_tables, m_link_view->get_target_table(), key_paths);
     if (!m_notifier) {
         m_notifier = std::make_shared<ListNotifier>(m_link_view, m_realm);
         RealmCoordinator::register_notifier(m_notifier);
     }
-    return {m_notifier, m_notifier->add_callback(std::move(cb))};
+    return {m_notifier, m_notifier->add_callback(std::move(cb), priority, std::move(observed_tables))};
 }
 
 List::OutOfBoundsIndexException::OutOfBoundsIndexException(size_t r, size_t c)
@@ -95,7 +95,13 @@ public:
 
     bool operator==(List const& rgt) const noexcept;
 
-    NotificationToken add_notification_callback(CollectionChangeCallback cb) &;
+    NotificationToken add_notification_callback(CollectionChangeCallback cb,
+                                                NotificationPriority priority=NotificationPriority::Interactive) &;
+    // Only report modifications to the given key paths of the objects in the
+    // list. Throws InvalidPropertyException if a key path is not valid.
+    NotificationToken add_notification_callback(CollectionChangeCallback cb,
+                                                std::vector<std::string> const& key_paths,
+                                                NotificationPriority priority=NotificationPriority::Interactive) &;
 
     // These are implemented in object_accessor.hpp
     template <typename ValueType, typename ContextType>
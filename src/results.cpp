@@ -90,6 +90,7 @@ Results::Results(Results&& other)
 , m_update_policy(other.m_update_policy)
 , m_has_used_table_view(other.m_has_used_table_view)
 , m_wants_background_updates(other.m_wants_background_updates)
+, m_query_matches_all_rows(other.m_query_matches_all_rows)
 {
     if (m_notifier) {
         m_notifier->target_results_moved(other, *this);
@@ -504,7 +505,9 @@ TableView Results::get_tableview()
 
 Results Results::sort(realm::SortDescriptor&& sort) const
 {
-    return Results(m_realm, get_query(), std::move(sort), m_distinct);
+    Results ret(m_realm, get_query(), std::move(sort), m_distinct);
+    ret.m_query_matches_all_rows = m_mode == Mode::Table || m_query_matches_all_rows;
+    return ret;
 }
 
 Results Results::filter(Query&& q) const
@@ -521,7 +524,9 @@ Results Results::distinct(realm::SortDescriptor&& uniqueness)
 {
     auto tv = get_tableview();
     tv.distinct(uniqueness);
-    return Results(m_realm, std::move(tv), m_sort, std::move(uniqueness));
+    Results ret(m_realm, std::move(tv), m_sort, std::move(uniqueness));
+    ret.m_query_matches_all_rows = m_mode == Mode::Table || m_query_matches_all_rows;
+    return ret;
 }
 
 Results Results::snapshot() const &
@@ -582,10 +587,21 @@ NotificationToken Results::async(std::function<void (std::exception_ptr)> target
     return {m_notifier, m_notifier->add_callback(wrap)};
 }
 
-NotificationToken Results::add_notification_callback(CollectionChangeCallback cb) &
+NotificationToken Results::add_notification_callback(CollectionChangeCallback cb, NotificationPriority priority) &
 {
     prepare_async();
-    return {m_notifier, m_notifier->add_callback(std::move(cb))};
+    return {m_notifier, m_notifier->add_callback(std::move(cb), priority)};
+}
+
+NotificationToken Results::add_notification_callback(CollectionChangeCallback cb,
+                                                     std::vector<std::string> const& key_paths,
+                                                     NotificationPriority priority) &
+{
+    std::vector<_impl::DeepChangeChecker::RelatedTable> observed_tables;
+    if (m_table && !key_paths.empty())
+        _impl::DeepChangeChecker::find_related_tables(observed_tables, *m_table, key_paths);
+    prepare_async();
+    return {m_notifier, m_notifier->add_callback(std::move(cb), priority, std::move(observed_tables))};
 }
 
 bool Results::is_in_table_order() const
@@ -604,6 +620,11 @@ bool Results::is_in_table_order() const
     REALM_UNREACHABLE(); // keep gcc happy
 }
 
+bool Results::Internal::query_matches_all_rows(Results const& results)
+{
+    return results.m_mode == Mode::Table || results.m_query_matches_all_rows;
+}
+
 void Results::Internal::set_table_view(Results& results, realm::TableView &&tv)
 {
     REALM_ASSERT(results.m_update_policy != UpdatePolicy::Never);
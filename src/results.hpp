@@ -181,7 +181,14 @@ public:
     // The query will be run on a background thread and delivered to the callback,
     // and then rerun after each commit (if needed) and redelivered if it changed
     NotificationToken async(std::function<void (std::exception_ptr)> target);
-    NotificationToken add_notification_callback(CollectionChangeCallback cb) &;
+    NotificationToken add_notification_callback(CollectionChangeCallback cb,
+                                                NotificationPriority priority=NotificationPriority::Interactive) &;
+    // Only report modifications to the given key paths, e.g. "name" or
+    // "owner.name", rather than to every property of every linked object.
+    // Throws InvalidPropertyException if a key path is not valid.
+    NotificationToken add_notification_callback(CollectionChangeCallback cb,
+                                                std::vector<std::string> const& key_paths,
+                                                NotificationPriority priority=NotificationPriority::Interactive) &;
 
     bool wants_background_updates() const { return m_wants_background_updates; }
 
@@ -193,6 +200,7 @@ public:
     class Internal {
         friend class _impl::ResultsNotifier;
         static void set_table_view(Results& results, TableView&& tv);
+        static bool query_matches_all_rows(Results const& results);
     };
     
 private:
@@ -216,6 +224,9 @@ private:
     UpdatePolicy m_update_policy = UpdatePolicy::Auto;
     bool m_has_used_table_view = false;
     bool m_wants_background_updates = true;
+    // True if m_query has no conditions, i.e. the Results was created from a
+    // Table and then only sorted or distincted
+    bool m_query_matches_all_rows = false;
 
     void update_tableview(bool wants_notifications = true);
     bool update_linkview();
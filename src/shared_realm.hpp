@@ -166,6 +166,41 @@ public:
         ShouldCompactOnLaunchFunction should_compact_on_launch_function;
 #endif
 
+        // The number of threads used to run async queries and other change
+        // notifiers for this file. With a value greater than one the notifiers
+        // are spread over additional worker threads, each of which holds its
+        // own read transaction, so that they are rerun in parallel after each
+        // commit. Only read when the file's notifier is first set up.
+        size_t async_notifier_threads = 1;
+
+        // On Linux and Android a single listener thread is shared by every
+        // Realm file which is open, so a slow query for one file delays
+        // notifications for all of them. Setting this gives this file's
+        // notifiers a thread of their own, with the shared thread only
+        // waking it up. Other platforms always use a thread per file.
+        bool dedicated_notifier_thread = false;
+
+        // The minimum time in milliseconds between runs of the async notifiers
+        // for this file. All of the commits made within the interval after a
+        // run are coalesced into a single run at the end of it, so this is
+        // also the maximum extra latency added to notifications. Runs which a
+        // thread is blocked waiting on (such as to begin a write transaction)
+        // are never delayed. Zero disables rate limiting. On Linux this should
+        // be combined with dedicated_notifier_thread, as otherwise the delay
+        // also holds up notifications for every other open file.
+        uint64_t async_notifier_min_interval_ms = 0;
+
+        // The maximum number of rows which the notifier for a sorted Results
+        // will search for moved rows in when calculating the changes to it.
+        // Past this, the change is instead reported as every row having been
+        // deleted and then reinserted, which is far cheaper to compute for
+        // large results where the rows were reordered. Zero means no limit.
+        // This applies to every sorted Results for this Realm, and only limits
+        // the search for moves: matching up the old and new rows, checking
+        // them for modifications and merging the changes from several commits
+        // still take time proportional to the size of the results.
+        size_t async_notifier_max_diff_rows = 0;
+
         bool read_only() const { return schema_mode == SchemaMode::ReadOnly; }
 
         // The following are intended for internal/testing purposes and
@@ -0,0 +1,211 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2017 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_UTIL_FLAT_INDEX_MAP_HPP
+#define REALM_UTIL_FLAT_INDEX_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace realm {
+namespace util {
+
+// A hash map from size_t to size_t which stores its entries inline in a single
+// array using open addressing with linear probing, rather than allocating a
+// node per entry like std::unordered_map. Intended for maps from row indices,
+// which are inserted and removed at a very high rate while parsing transaction
+// logs. The storage is kept when the map is cleared so that it can be reused.
+//
+// The key size_t(-1) is reserved to mark empty slots. Inserting into or
+// erasing from the map invalidates all iterators and references into it.
+class FlatIndexMap {
+public:
+    struct value_type {
+        size_t first;
+        size_t second;
+    };
+
+    template<typename T>
+    class Iterator : public std::iterator<std::forward_iterator_tag, T> {
+    public:
+        Iterator(T* pos, T* end) : m_pos(pos), m_end(end) { skip_empty(); }
+
+        T& operator*() const noexcept { return *m_pos; }
+        T* operator->() const noexcept { return m_pos; }
+
+        Iterator& operator++() noexcept
+        {
+            ++m_pos;
+            skip_empty();
+            return *this;
+        }
+        Iterator operator++(int) noexcept
+        {
+            auto tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        bool operator==(Iterator const& it) const noexcept { return m_pos == it.m_pos; }
+        bool operator!=(Iterator const& it) const noexcept { return m_pos != it.m_pos; }
+
+    private:
+        friend class FlatIndexMap;
+        T* m_pos;
+        T* m_end;
+
+        void skip_empty() noexcept
+        {
+            while (m_pos != m_end && m_pos->first == empty_key)
+                ++m_pos;
+        }
+    };
+    using iterator = Iterator<value_type>;
+    using const_iterator = Iterator<const value_type>;
+
+    iterator begin() noexcept { return {data(), data() + m_slots.size()}; }
+    iterator end() noexcept { return {data() + m_slots.size(), data() + m_slots.size()}; }
+    const_iterator begin() const noexcept { return {data(), data() + m_slots.size()}; }
+    const_iterator end() const noexcept { return {data() + m_slots.size(), data() + m_slots.size()}; }
+
+    size_t size() const noexcept { return m_size; }
+    bool empty() const noexcept { return m_size == 0; }
+
+    iterator find(size_t key) noexcept
+    {
+        size_t i = find_slot(key);
+        return i == empty_key ? end() : iterator{data() + i, data() + m_slots.size()};
+    }
+
+    size_t count(size_t key) const noexcept { return find_slot(key) != empty_key; }
+
+    // Get the value for the key, inserting a zero value if it isn't present
+    size_t& operator[](size_t key)
+    {
+        if ((m_size + 1) * 2 > m_slots.size())
+            grow();
+        size_t mask = m_slots.size() - 1;
+        size_t i = slot_for(key);
+        for (; m_slots[i].first != empty_key; i = (i + 1) & mask) {
+            if (m_slots[i].first == key)
+                return m_slots[i].second;
+        }
+        m_slots[i] = {key, 0};
+        ++m_size;
+        return m_slots[i].second;
+    }
+
+    void erase(size_t key) noexcept
+    {
+        auto it = find(key);
+        if (it != end())
+            erase(it);
+    }
+
+    void erase(iterator it) noexcept
+    {
+        // Rather than leaving a tombstone, move any following entries which
+        // would have wanted to be in the erased slot back into it
+        size_t mask = m_slots.size() - 1;
+        size_t hole = it.m_pos - data();
+        for (size_t i = (hole + 1) & mask; m_slots[i].first != empty_key; i = (i + 1) & mask) {
+            size_t home = slot_for(m_slots[i].first);
+            // Can the entry at i be moved to the hole, i.e. is its home slot
+            // not cyclically within (hole, i]?
+            bool home_between = hole <= i ? (hole < home && home <= i) : (hole < home || home <= i);
+            if (!home_between) {
+                m_slots[hole] = m_slots[i];
+                hole = i;
+            }
+        }
+        m_slots[hole].first = empty_key;
+        --m_size;
+    }
+
+    // Remove all entries while keeping the allocated storage
+    void clear() noexcept
+    {
+        if (m_size == 0)
+            return;
+        for (auto& slot : m_slots)
+            slot.first = empty_key;
+        m_size = 0;
+    }
+
+    // Add `count` to every key which is at least `index`
+    void shift_keys(size_t index, size_t count)
+    {
+        std::vector<value_type> entries;
+        entries.reserve(m_size);
+        for (auto& entry : *this)
+            entries.push_back(entry);
+        clear();
+        for (auto& entry : entries)
+            (*this)[entry.first >= index ? entry.first + count : entry.first] = entry.second;
+    }
+
+private:
+    static const size_t empty_key = size_t(-1);
+
+    std::vector<value_type> m_slots;
+    size_t m_size = 0;
+    unsigned m_bits = 0;
+
+    value_type* data() noexcept { return m_slots.data(); }
+    value_type const* data() const noexcept { return m_slots.data(); }
+
+    // Get the index of the slot containing the key, or empty_key if it isn't present
+    size_t find_slot(size_t key) const noexcept
+    {
+        if (m_size == 0)
+            return empty_key;
+        size_t mask = m_slots.size() - 1;
+        for (size_t i = slot_for(key); ; i = (i + 1) & mask) {
+            if (m_slots[i].first == key)
+                return i;
+            if (m_slots[i].first == empty_key)
+                return empty_key;
+        }
+    }
+
+    size_t slot_for(size_t key) const noexcept
+    {
+        // Fibonacci hashing, as row indices are often sequential
+        return size_t((uint64_t(key) * 0x9E3779B97F4A7C15ULL) >> (64 - m_bits));
+    }
+
+    void grow()
+    {
+        std::vector<value_type> old;
+        old.swap(m_slots);
+        m_bits = m_bits ? m_bits + 1 : 4;
+        m_slots.assign(size_t(1) << m_bits, value_type{empty_key, 0});
+        m_size = 0;
+        for (auto& entry : old) {
+            if (entry.first != empty_key)
+                (*this)[entry.first] = entry.second;
+        }
+    }
+};
+
+} // namespace util
+} // namespace realm
+
+#endif // REALM_UTIL_FLAT_INDEX_MAP_HPP
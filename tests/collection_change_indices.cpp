@@ -22,7 +22,9 @@
 
 #include "util/index_helpers.hpp"
 
+#include <algorithm>
 #include <limits>
+#include <numeric>
 
 using namespace realm;
 
@@ -96,6 +98,18 @@ TEST_CASE("collection_change: modify()") {
         REQUIRE(c.columns.empty());
     }
 
+    SECTION("tracks the modified columns unless disabled") {
+        c.modify(5, 1);
+        REQUIRE_COLUMN_INDICES(c.columns, 1, 5);
+
+        _impl::CollectionChangeBuilder c2;
+        c2.set_track_columns(false);
+        c2.modify(5, 1);
+        c2.insert(0);
+        REQUIRE_INDICES(c2.modifications, 6);
+        REQUIRE(c2.columns.empty());
+    }
+
     SECTION("marks the appropriate column as modified when applicable") {
         c.modify(5, 2);
         REQUIRE_INDICES(c.modifications, 5);
@@ -911,6 +925,60 @@ TEST_CASE("collection_change: calculate() sorted") {
         REQUIRE_INDICES(c.insertions, 0, 3, 7, 10);
     }
 
+    SECTION("handles rows which are made up of several sorted runs") {
+        c = _impl::CollectionChangeBuilder::calculate({1, 2, 3, 10, 11, 12, 4, 5, 6},
+                                                      {1, 2, 3, 4, 5, 6, 10, 11, 12},
+                                                      none_modified);
+        REQUIRE_INDICES(c.deletions, 6, 7, 8);
+        REQUIRE_INDICES(c.insertions, 3, 4, 5);
+
+        std::vector<size_t> many_runs;
+        for (size_t run = 0; run < 12; ++run) {
+            for (size_t i = 0; i < 3; ++i)
+                many_runs.push_back((11 - run) * 3 + i);
+        }
+        std::vector<size_t> sorted = many_runs;
+        std::sort(sorted.begin(), sorted.end());
+        c = _impl::CollectionChangeBuilder::calculate(many_runs, sorted, none_modified);
+        REQUIRE(c.deletions.count() == 33);
+        REQUIRE(c.insertions.count() == 33);
+    }
+
+    SECTION("reports everything as replaced when the diff would exceed the row limit") {
+        c = _impl::CollectionChangeBuilder::calculate({1, 2, 3, 4}, {1, 3, 2, 4, 5}, all_modified,
+                                                      util::none, nullptr, 2);
+        REQUIRE_INDICES(c.deletions, 0, 1, 2, 3);
+        REQUIRE_INDICES(c.insertions, 0, 1, 2, 3, 4);
+        REQUIRE(c.modifications.empty());
+        REQUIRE(c.moves.empty());
+    }
+
+    SECTION("calculates the normal diff within the row limit") {
+        c = _impl::CollectionChangeBuilder::calculate({1, 2, 3, 4}, {1, 3, 2, 4, 5}, none_modified,
+                                                      util::none, nullptr, 3);
+        REQUIRE_INDICES(c.deletions, 2);
+        REQUIRE_INDICES(c.insertions, 1, 4);
+
+        // Insertions and deletions alone don't need any searching
+        c = _impl::CollectionChangeBuilder::calculate({1, 2, 3, 4}, {1, 3, 4, 5}, none_modified,
+                                                      util::none, nullptr, 0);
+        REQUIRE_INDICES(c.deletions, 1);
+        REQUIRE_INDICES(c.insertions, 3);
+    }
+
+    SECTION("handles long runs of small reorderings") {
+        std::vector<size_t> prev, next;
+        for (size_t i = 0; i < 2000; i += 2) {
+            prev.push_back(i + 1);
+            prev.push_back(i);
+            next.push_back(i);
+            next.push_back(i + 1);
+        }
+        c = _impl::CollectionChangeBuilder::calculate(prev, next, none_modified);
+        REQUIRE(c.deletions.count() == 1000);
+        REQUIRE(c.insertions.count() == 1000);
+    }
+
     SECTION("produces diffs which let merge collapse insert -> move -> delete to no-op") {
         auto four_modified = [](size_t ndx) { return ndx == 4; };
         for (int insert_pos = 0; insert_pos < 4; ++insert_pos) {
@@ -935,6 +1003,80 @@ TEST_CASE("collection_change: calculate() sorted") {
     }
 }
 
+TEST_CASE("collection_change: calculate() with row indices which do not fit in 32 bits") {
+    // Only meaningful where size_t is larger than the compact index type
+    if (sizeof(size_t) <= sizeof(uint32_t))
+        return;
+
+    // Straddle the largest value which fits, so that some rows fit and others
+    // don't, and check that the changes match the same rows with small indices
+    const size_t base = std::numeric_limits<uint32_t>::max() - 2;
+    std::vector<size_t> changed;
+    auto record_modified = [&](size_t row) { changed.push_back(row); return row == base + 3; };
+    auto small_modified = [](size_t row) { return row == 3; };
+    auto shifted = [&](std::vector<size_t> rows) {
+        for (auto& row : rows)
+            row += base;
+        return rows;
+    };
+    auto indices = [](IndexSet const& set) {
+        return std::vector<size_t>(set.as_indexes().begin(), set.as_indexes().end());
+    };
+
+    SECTION("sorted") {
+        auto expected = _impl::CollectionChangeBuilder::calculate({0, 1, 2, 3, 4}, {4, 1, 3, 0, 5}, small_modified);
+        auto c = _impl::CollectionChangeBuilder::calculate(shifted({0, 1, 2, 3, 4}), shifted({4, 1, 3, 0, 5}),
+                                                           record_modified);
+        REQUIRE(indices(c.deletions) == indices(expected.deletions));
+        REQUIRE(indices(c.insertions) == indices(expected.insertions));
+        REQUIRE(indices(c.modifications) == indices(expected.modifications));
+        REQUIRE(std::find(changed.begin(), changed.end(), base + 3) != changed.end());
+    }
+
+    SECTION("unsorted") {
+        IndexSet candidates;
+        for (auto row : shifted({0, 1, 2, 3, 4, 5}))
+            candidates.add(row);
+        auto expected = _impl::CollectionChangeBuilder::calculate({0, 1, 2, 3, 4}, {0, 3, 4, 5}, small_modified,
+                                                                  IndexSet{0, 1, 2, 3, 4, 5});
+        auto c = _impl::CollectionChangeBuilder::calculate(shifted({0, 1, 2, 3, 4}), shifted({0, 3, 4, 5}),
+                                                           record_modified, candidates);
+        REQUIRE(indices(c.deletions) == indices(expected.deletions));
+        REQUIRE(indices(c.insertions) == indices(expected.insertions));
+        REQUIRE(indices(c.modifications) == indices(expected.modifications));
+        REQUIRE(c.moves == expected.moves);
+    }
+}
+
+TEST_CASE("collection_change: calculate() cancellation") {
+    size_t checked = 0;
+    auto count_modified = [&](size_t) { ++checked; return true; };
+
+    SECTION("does not check any rows for modifications if cancelled immediately") {
+        _impl::CollectionChangeBuilder::calculate({1, 2, 3}, {3, 2, 1}, count_modified, util::none,
+                                                  [] { return true; });
+        REQUIRE(checked == 0);
+    }
+
+    SECTION("stops checking rows for modifications once cancelled") {
+        std::vector<size_t> rows(5000);
+        std::iota(rows.begin(), rows.end(), 0);
+        size_t polls = 0;
+        _impl::CollectionChangeBuilder::calculate(rows, rows, count_modified, util::none,
+                                                  [&] { return ++polls > 2; });
+        REQUIRE(checked > 0);
+        REQUIRE(checked < rows.size());
+    }
+
+    SECTION("produces the normal result if never cancelled") {
+        auto c = _impl::CollectionChangeBuilder::calculate({1, 2, 3}, {1, 3, 4}, count_modified, util::none,
+                                                           [] { return false; });
+        REQUIRE_INDICES(c.deletions, 1);
+        REQUIRE_INDICES(c.insertions, 2);
+        REQUIRE_INDICES(c.modifications, 0, 1);
+    }
+}
+
 TEST_CASE("collection_change: merge()") {
     _impl::CollectionChangeBuilder c;
 
@@ -958,6 +1100,31 @@ TEST_CASE("collection_change: merge()") {
         REQUIRE_MOVES(c, {8, 9});
     }
 
+    SECTION("updates the destinations of many old moves which were moved again") {
+        const size_t n = 100;
+        IndexSet first_half, second_half;
+        first_half.set(n);
+        second_half.set(n);
+        second_half.shift_for_insert_at(0, n);
+        std::vector<CollectionChangeSet::Move> moves, moves2;
+        for (size_t i = 0; i < n; ++i) {
+            moves.push_back({i, n + i});
+            moves2.push_back({n + i, 2 * n - 1 - i});
+        }
+        c = {first_half, second_half, {}, moves};
+        c.merge({second_half, second_half, {}, moves2});
+
+        REQUIRE(c.deletions.count() == n);
+        REQUIRE(c.deletions.contains(0));
+        REQUIRE(c.insertions.count() == n);
+        REQUIRE(c.insertions.contains(n));
+        REQUIRE(c.moves.size() == n);
+        for (size_t i = 0; i < n; ++i) {
+            REQUIRE(c.moves[i].from == i);
+            REQUIRE(c.moves[i].to == 2 * n - 1 - i);
+        }
+    }
+
     SECTION("shifts deletions by previous deletions") {
         c = {{5}, {}, {}, {}};
         c.merge({{3}, {}, {}, {}});
@@ -1235,3 +1402,52 @@ TEST_CASE("collection_change: merge()") {
         }
     }
 }
+
+TEST_CASE("collection_change: CollectionChangeView") {
+    _impl::CollectionChangeBuilder c;
+    c.insert(1, 2);
+    c.modify(2);
+    c.modify(5);
+    c.erase(7);
+    c.modify(8);
+    c.insert(9);
+    c.modify(9);
+    c.modify(12);
+    c.move(3, 10);
+    c.modify(14);
+    c.erase(0);
+    c.modify(0);
+
+    auto copy = c;
+    auto full = std::move(copy).finalize();
+    auto lazy = std::move(c).finalize_lazily();
+
+    std::vector<std::pair<size_t, size_t>> expected;
+    auto old_it = full.modifications.as_indexes().begin();
+    for (auto new_ndx : full.modifications_new.as_indexes())
+        expected.push_back({*old_it++, new_ndx});
+    REQUIRE_FALSE(expected.empty());
+
+    SECTION("reports the modifications of a full changeset") {
+        CollectionChangeView view(full);
+        std::vector<std::pair<size_t, size_t>> actual;
+        view.for_each_modification([&](size_t old_ndx, size_t new_ndx) {
+            actual.push_back({old_ndx, new_ndx});
+        });
+        REQUIRE(actual == expected);
+        REQUIRE(view.modification_count() == expected.size());
+    }
+
+    SECTION("calculates the same modifications from a lazy changeset") {
+        CollectionChangeView view(lazy, true);
+        std::vector<std::pair<size_t, size_t>> actual;
+        view.for_each_modification([&](size_t old_ndx, size_t new_ndx) {
+            actual.push_back({old_ndx, new_ndx});
+        });
+        REQUIRE(actual == expected);
+        REQUIRE(view.modification_count() == expected.size());
+        REQUIRE(view.deletions().count() == full.deletions.count());
+        REQUIRE(view.insertions().count() == full.insertions.count());
+        REQUIRE(view.moves().size() == full.moves.size());
+    }
+}
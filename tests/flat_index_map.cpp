@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2017 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "util/flat_index_map.hpp"
+
+#include <map>
+#include <random>
+
+using namespace realm;
+
+TEST_CASE("flat_index_map") {
+    util::FlatIndexMap map;
+
+    SECTION("is initially empty") {
+        REQUIRE(map.empty());
+        REQUIRE(map.size() == 0);
+        REQUIRE(map.begin() == map.end());
+        REQUIRE(map.find(0) == map.end());
+        REQUIRE(map.count(0) == 0);
+    }
+
+    SECTION("operator[] inserts a zero value for new keys") {
+        REQUIRE(map[5] == 0);
+        REQUIRE(map.size() == 1);
+        map[5] = 10;
+        REQUIRE(map[5] == 10);
+        REQUIRE(map.size() == 1);
+    }
+
+    SECTION("find() returns the entry for the key") {
+        map[1] = 2;
+        map[3] = 4;
+        auto it = map.find(3);
+        REQUIRE(it != map.end());
+        REQUIRE(it->first == 3);
+        REQUIRE(it->second == 4);
+        REQUIRE(map.find(2) == map.end());
+    }
+
+    SECTION("erase() removes only the given key") {
+        for (size_t i = 0; i < 100; ++i)
+            map[i] = i * 2;
+        map.erase(map.find(50));
+        map.erase(size_t(10));
+        map.erase(size_t(1000));
+        REQUIRE(map.size() == 98);
+        REQUIRE(map.count(50) == 0);
+        REQUIRE(map.count(10) == 0);
+        for (size_t i = 0; i < 100; ++i) {
+            if (i == 10 || i == 50)
+                continue;
+            REQUIRE(map.find(i)->second == i * 2);
+        }
+    }
+
+    SECTION("iteration visits every entry once") {
+        for (size_t i = 0; i < 100; ++i)
+            map[i * 7] = i;
+        std::map<size_t, size_t> seen;
+        for (auto& entry : map)
+            seen[entry.first] = entry.second;
+        REQUIRE(seen.size() == 100);
+        for (size_t i = 0; i < 100; ++i)
+            REQUIRE(seen[i * 7] == i);
+    }
+
+    SECTION("clear() removes all entries and the map is still usable") {
+        for (size_t i = 0; i < 100; ++i)
+            map[i] = i;
+        map.clear();
+        REQUIRE(map.empty());
+        REQUIRE(map.begin() == map.end());
+        REQUIRE(map.count(5) == 0);
+        map[5] = 1;
+        REQUIRE(map.size() == 1);
+        REQUIRE(map.find(5)->second == 1);
+    }
+
+    SECTION("shift_keys() shifts only keys at or after the index") {
+        map[1] = 10;
+        map[5] = 50;
+        map[9] = 90;
+        map.shift_keys(5, 3);
+        REQUIRE(map.size() == 3);
+        REQUIRE(map.find(1)->second == 10);
+        REQUIRE(map.find(8)->second == 50);
+        REQUIRE(map.find(12)->second == 90);
+        REQUIRE(map.count(5) == 0);
+        REQUIRE(map.count(9) == 0);
+    }
+
+    SECTION("matches std::map for random operations") {
+        std::map<size_t, size_t> expected;
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<size_t> key_dist(0, 500);
+        for (size_t i = 0; i < 20000; ++i) {
+            size_t key = key_dist(rng);
+            switch (rng() % 3) {
+                case 0:
+                    map[key] = i;
+                    expected[key] = i;
+                    break;
+                case 1:
+                    map.erase(key);
+                    expected.erase(key);
+                    break;
+                case 2:
+                    REQUIRE(map.count(key) == expected.count(key));
+                    break;
+            }
+        }
+        REQUIRE(map.size() == expected.size());
+        for (auto& entry : expected)
+            REQUIRE(map.find(entry.first)->second == entry.second);
+    }
+}
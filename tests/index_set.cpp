@@ -22,6 +22,9 @@
 
 #include "util/index_helpers.hpp"
 
+#include <random>
+#include <set>
+
 TEST_CASE("index_set: contains()") {
     SECTION("returns false if the index is before the first entry in the set") {
         realm::IndexSet set = {1, 2, 5};
@@ -149,6 +152,36 @@ TEST_CASE("index_set: add()") {
         set.add(set2);
         REQUIRE(set.count() == 30);
     }
+
+    SECTION("appends indices which are added in ascending order") {
+        size_t count = realm::_impl::ChunkedRangeVector::max_size * 4;
+        for (size_t i = 0; i < count; ++i) {
+            set.add(i * 3);
+            set.add(i * 3 + 1);
+        }
+        set.verify();
+        REQUIRE(set.count() == count * 2);
+        REQUIRE(std::distance(set.begin(), set.end()) == ptrdiff_t(count));
+        REQUIRE(set.count(0, count * 3 / 2) == count);
+    }
+
+    SECTION("merges large sets with overlapping ranges") {
+        std::set<size_t> expected;
+        realm::IndexSet set2;
+        std::mt19937 rng(3);
+        for (size_t i = 0; i < 500; ++i) {
+            size_t a = rng() % 1000, b = rng() % 1000;
+            set.add(a);
+            set2.add(b);
+            expected.insert(a);
+            expected.insert(b);
+        }
+        set2.add(realm::IndexSet{});
+        set.add(set2);
+        set.verify();
+        std::vector<size_t> actual(set.as_indexes().begin(), set.as_indexes().end());
+        REQUIRE(actual == std::vector<size_t>(expected.begin(), expected.end()));
+    }
 }
 
 TEST_CASE("index_set: add_shifted()") {
@@ -571,6 +604,29 @@ TEST_CASE("index_set: remove()") {
         set.remove({6, 11, 13});
         REQUIRE_INDICES(set, 5, 7, 10, 12, 15);
     }
+
+    SECTION("removes a large set spanning many chunks") {
+        std::set<size_t> expected;
+        realm::IndexSet to_remove;
+        std::mt19937 rng(5);
+        for (size_t i = 0; i < 1000; ++i) {
+            if (rng() % 4) {
+                set.add(i);
+                expected.insert(i);
+            }
+            if (rng() % 3 == 0) {
+                to_remove.add(i);
+                expected.erase(i);
+            }
+        }
+        set.remove(to_remove);
+        set.verify();
+        std::vector<size_t> actual(set.as_indexes().begin(), set.as_indexes().end());
+        REQUIRE(actual == std::vector<size_t>(expected.begin(), expected.end()));
+
+        set.remove(set);
+        REQUIRE(set.empty());
+    }
 }
 
 TEST_CASE("index_set: shift()") {
@@ -586,6 +642,68 @@ TEST_CASE("index_set: shift()") {
     }
 }
 
+TEST_CASE("index_set: shift() and unshift() across chunks") {
+    size_t count = realm::_impl::ChunkedRangeVector::max_size * 4;
+    realm::IndexSet set;
+    for (size_t i = 0; i < count; ++i) {
+        set.add(i * 3);
+        set.add(i * 3 + 1);
+    }
+
+    SECTION("match shifting by each range in turn") {
+        for (size_t i = 0; i < count * 3; ++i) {
+            size_t expected = i;
+            for (auto range : set) {
+                if (range.first > expected)
+                    break;
+                expected += range.second - range.first;
+            }
+            REQUIRE(set.shift(i) == expected);
+            if (i % 3 == 2)
+                REQUIRE(set.unshift(i) == i - (i + 1) / 3 * 2);
+        }
+    }
+
+    SECTION("stay correct after modifying an earlier chunk") {
+        set.erase_at(3);
+        set.remove(0);
+        REQUIRE(set.count() == 2 * count - 2);
+        REQUIRE(set.count(0, 4) == 2);
+        REQUIRE(set.shift(0) == 0);
+        REQUIRE(set.shift(1) == 2);
+        REQUIRE(set.shift(2) == 4);
+        REQUIRE(set.unshift(count * 3 - 2) == count);
+    }
+}
+
+TEST_CASE("index_set: nth()") {
+    realm::IndexSet set;
+
+    SECTION("returns npos for an empty set") {
+        REQUIRE(set.nth(0) == realm::IndexSet::npos);
+    }
+
+    SECTION("returns the nth index in the set") {
+        set = {1, 3, 4, 5, 10};
+        REQUIRE(set.nth(0) == 1);
+        REQUIRE(set.nth(1) == 3);
+        REQUIRE(set.nth(3) == 5);
+        REQUIRE(set.nth(4) == 10);
+        REQUIRE(set.nth(5) == realm::IndexSet::npos);
+    }
+
+    SECTION("handles full chunks well") {
+        size_t count = realm::_impl::ChunkedRangeVector::max_size * 4;
+        for (size_t i = 0; i < count; ++i) {
+            set.add(i * 3);
+            set.add(i * 3 + 1);
+        }
+        for (size_t i = 0; i < count * 2; ++i)
+            REQUIRE(set.nth(i) == i / 2 * 3 + i % 2);
+        REQUIRE(set.nth(count * 2) == realm::IndexSet::npos);
+    }
+}
+
 TEST_CASE("index_set: unshift()") {
     realm::IndexSet set;
 
@@ -608,3 +726,154 @@ TEST_CASE("index_set: clear()") {
         REQUIRE(set.empty());
     }
 }
+
+TEST_CASE("index_set: bitmap chunks") {
+    // Bulk operations store chunks of scattered indices as bitmaps, so build
+    // a scattered set and then run the operation on both it and a std::set
+    realm::IndexSet set;
+    std::set<size_t> expected;
+    for (size_t i = 0; i < 1000; i += 2) {
+        set.add(i);
+        expected.insert(i);
+    }
+    set.add(1001);
+    set.erase_at(realm::IndexSet{1000});
+    expected.insert(1000);
+
+    auto check = [&] {
+        set.verify();
+        std::vector<size_t> actual(set.as_indexes().begin(), set.as_indexes().end());
+        REQUIRE(actual == std::vector<size_t>(expected.begin(), expected.end()));
+    };
+    check();
+
+    SECTION("can be iterated in both directions") {
+        std::vector<std::pair<size_t, size_t>> forward(set.begin(), set.end());
+        std::vector<std::pair<size_t, size_t>> backward;
+        for (auto it = set.end(); it != set.begin(); )
+            backward.push_back(*--it);
+        std::reverse(backward.begin(), backward.end());
+        REQUIRE(forward == backward);
+        REQUIRE(forward.size() == 501);
+        REQUIRE(forward.back() == std::make_pair(size_t(1000), size_t(1001)));
+    }
+
+    SECTION("can be iterated with a reverse iterator") {
+        std::vector<std::pair<size_t, size_t>> forward(set.begin(), set.end());
+        std::vector<std::pair<size_t, size_t>> backward;
+        auto it = realm::util::make_reverse_iterator(set.end());
+        auto end = realm::util::make_reverse_iterator(set.begin());
+        for (; it != end; ++it)
+            backward.push_back(*it);
+        std::reverse(backward.begin(), backward.end());
+        REQUIRE(forward == backward);
+    }
+
+    SECTION("returns ranges which stay valid after the iterator advances") {
+        auto it = set.begin();
+        auto first = *it;
+        auto next = *++it;
+        REQUIRE(first == std::make_pair(size_t(0), size_t(1)));
+        REQUIRE(next == std::make_pair(size_t(2), size_t(3)));
+    }
+
+    SECTION("answers queries the same as ranges") {
+        for (size_t i = 0; i < 1010; ++i) {
+            REQUIRE(set.contains(i) == (expected.count(i) == 1));
+            size_t before = std::distance(expected.begin(), expected.lower_bound(i));
+            REQUIRE(set.count(0, i) == before);
+            REQUIRE(set.count(i) == expected.size() - before);
+            REQUIRE(set.count(i, i + 7) == size_t(std::distance(expected.lower_bound(i), expected.lower_bound(i + 7))));
+            if (!set.contains(i))
+                REQUIRE(set.unshift(i) == i - before);
+            size_t shifted = i;
+            for (auto index : expected) {
+                if (index <= shifted)
+                    ++shifted;
+            }
+            REQUIRE(set.shift(i) == shifted);
+        }
+    }
+
+    SECTION("can be modified after a bulk operation") {
+        std::mt19937 rng(7);
+        for (size_t i = 0; i < 2000; ++i) {
+            size_t index = rng() % 1100;
+            switch (rng() % 5) {
+                case 0: {
+                    set.add(index);
+                    expected.insert(index);
+                    break;
+                }
+                case 1: {
+                    set.remove(index);
+                    expected.erase(index);
+                    break;
+                }
+                case 2: {
+                    set.erase_at(index);
+                    std::set<size_t> shifted;
+                    for (auto i : expected) {
+                        if (i != index)
+                            shifted.insert(i > index ? i - 1 : i);
+                    }
+                    expected = std::move(shifted);
+                    break;
+                }
+                case 3: {
+                    set.insert_at(index);
+                    std::set<size_t> shifted = {index};
+                    for (auto i : expected)
+                        shifted.insert(i >= index ? i + 1 : i);
+                    expected = std::move(shifted);
+                    break;
+                }
+                case 4: {
+                    // Spread the indices out and then shift them back, which
+                    // repacks the chunks
+                    realm::IndexSet positions;
+                    for (size_t j = index % 3; j < 1100; j += 3)
+                        positions.add(j);
+                    std::set<size_t> unshifted = expected, shifted;
+                    for (auto i : expected) {
+                        size_t shift = 0;
+                        for (auto p : positions.as_indexes()) {
+                            if (p > i + shift)
+                                break;
+                            ++shift;
+                        }
+                        shifted.insert(i + shift);
+                    }
+                    set.shift_for_insert_at(positions);
+                    expected = std::move(shifted);
+                    check();
+                    set.erase_at(positions);
+                    expected = std::move(unshifted);
+                    break;
+                }
+            }
+            if (i % 100 == 0)
+                check();
+        }
+        check();
+    }
+}
+
+TEST_CASE("index_set: chunk buffers") {
+    using realm::_impl::ChunkBufferPool;
+    auto build = [] {
+        realm::IndexSet set;
+        for (size_t i = 0; i < 40; ++i)
+            set.add(i * 2);
+        REQUIRE(set.count() == 40);
+    };
+
+    SECTION("are reused by later sets after being freed") {
+        build();
+        auto before = ChunkBufferPool::stats();
+        build();
+        auto after = ChunkBufferPool::stats();
+        REQUIRE(after.allocations > before.allocations);
+        REQUIRE(after.reused - before.reused == after.allocations - before.allocations);
+    }
+}
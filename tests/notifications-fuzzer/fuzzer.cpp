@@ -124,7 +124,8 @@ static auto verify(CollectionChangeIndices const& changes, std::vector<int64_t>
     auto it = util::make_reverse_iterator(changes.deletions.end());
     auto end = util::make_reverse_iterator(changes.deletions.begin());
     for (; it != end; ++it) {
-        values.erase(values.begin() + it->first, values.begin() + it->second);
+        auto range = *it;
+        values.erase(values.begin() + range.first, values.begin() + range.second);
     }
 
     for (auto i : changes.insertions.as_indexes()) {
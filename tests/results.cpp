@@ -25,6 +25,7 @@
 
 #include "impl/realm_coordinator.hpp"
 #include "binding_context.hpp"
+#include "object.hpp"
 #include "object_schema.hpp"
 #include "property.hpp"
 #include "results.hpp"
@@ -35,6 +36,10 @@
 #include <realm/query_engine.hpp>
 #include <realm/query_expression.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #if REALM_ENABLE_SYNC
 #include "sync/sync_manager.hpp"
 #include "sync/sync_session.hpp"
@@ -313,6 +318,38 @@ TEST_CASE("notifications: async delivery") {
         advance_and_notify(*r);
     }
 
+    SECTION("callbacks added between calculation and delivery only see later changes") {
+        advance_and_notify(*r);
+
+        std::vector<CollectionChangeSet> changes(3);
+        std::vector<NotificationToken> tokens;
+        auto add_callback = [&](size_t i) {
+            tokens.push_back(results.add_notification_callback([&, i](CollectionChangeSet c, std::exception_ptr) {
+                changes[i] = std::move(c);
+            }));
+        };
+        add_callback(0);
+        add_callback(1);
+
+        make_remote_change();
+        coordinator->on_change();
+
+        add_callback(2);
+        auto r2 = coordinator->get_realm();
+        r2->begin_transaction();
+        r2->read_group().get_table("class_object")->set_int(0, 1, 3);
+        r2->commit_transaction();
+        coordinator->on_change();
+        r->notify();
+
+        for (size_t i = 0; i < 2; ++i) {
+            REQUIRE_INDICES(changes[i].insertions, 0);
+            REQUIRE_INDICES(changes[i].modifications_new, 1);
+        }
+        REQUIRE(changes[2].insertions.empty());
+        REQUIRE_INDICES(changes[2].modifications_new, 1);
+    }
+
     SECTION("handling of results not ready") {
         make_remote_change();
 
@@ -866,6 +903,862 @@ TEST_CASE("notifications: skip") {
     }
 }
 
+TEST_CASE("notifications: parallel notifier workers") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.async_notifier_threads = 3;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+        {"large", {
+            {"value", PropertyType::Int}
+        }},
+    });
+
+    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
+    auto table = r->read_group().get_table("class_object");
+
+    r->begin_transaction();
+    table->add_empty_row(10);
+    for (int i = 0; i < 10; ++i)
+        table->set_int(0, i, i);
+    r->commit_transaction();
+
+    // More Results than workers so that some share a worker
+    std::vector<Results> results;
+    for (int i = 0; i < 5; ++i)
+        results.push_back(Results(r, table->where().greater_equal(0, i)));
+
+    std::vector<int> calls(results.size());
+    std::vector<CollectionChangeSet> changes(results.size());
+    std::vector<NotificationToken> tokens;
+    for (size_t i = 0; i < results.size(); ++i) {
+        tokens.push_back(results[i].add_notification_callback([&, i](CollectionChangeSet c, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            ++calls[i];
+            changes[i] = std::move(c);
+        }));
+    }
+
+    advance_and_notify(*r);
+    for (size_t i = 0; i < results.size(); ++i) {
+        REQUIRE(calls[i] == 1);
+        REQUIRE(results[i].size() == 10 - i);
+    }
+
+    SECTION("each notifier reports its own changes") {
+        r->begin_transaction();
+        table->set_int(0, 2, -1);
+        r->commit_transaction();
+        advance_and_notify(*r);
+
+        for (size_t i = 0; i < results.size(); ++i) {
+            REQUIRE(calls[i] == 2);
+            if (i <= 2)
+                REQUIRE_INDICES(changes[i].deletions, 2 - i);
+            else
+                REQUIRE(changes[i].deletions.empty());
+        }
+    }
+
+    SECTION("notifiers added after the first run are also delivered") {
+        Results late(r, table->where().less(0, 5));
+        int late_calls = 0;
+        CollectionChangeSet late_changes;
+        auto late_token = late.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            ++late_calls;
+            late_changes = std::move(c);
+        });
+        advance_and_notify(*r);
+        REQUIRE(late_calls == 1);
+
+        r->begin_transaction();
+        table->add_empty_row();
+        r->commit_transaction();
+        advance_and_notify(*r);
+
+        REQUIRE(late_calls == 2);
+        REQUIRE_INDICES(late_changes.insertions, 5);
+        for (size_t i = 0; i < results.size(); ++i)
+            REQUIRE(calls[i] == (i == 0 ? 2 : 1));
+    }
+
+    SECTION("notifiers for other Realms don't hold up delivery") {
+        // A notifier for another Realm which has to re-sort a large table on
+        // every write takes far longer to run than all of r's notifiers
+        const size_t large_size = 50000;
+        auto large = r->read_group().get_table("class_large");
+        r->begin_transaction();
+        large->add_empty_row(large_size);
+        for (size_t i = 0; i < large_size; ++i)
+            large->set_int(0, i, i);
+        r->commit_transaction();
+        advance_and_notify(*r);
+
+        auto r2 = coordinator->get_realm();
+        auto large2 = r2->read_group().get_table("class_large");
+        Results other = Results(r2, large2->where().greater_equal(0, 0)).sort({*large2, {{0}}});
+        int other_calls = 0;
+        auto other_token = other.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            ++other_calls;
+        });
+        advance_and_notify(*r2);
+        REQUIRE(other_calls == 1);
+
+        r->begin_transaction();
+        table->set_int(0, 0, -5);
+        for (size_t i = 0; i < large_size; ++i)
+            large->set_int(0, i, (i * 7919) % large_size);
+        r->commit_transaction();
+
+        // Deliver r's notifications while the other Realm's notifier is still
+        // running, which is only possible if they're handed over as soon as
+        // they're ready rather than once everything has run
+        std::atomic<bool> done{false};
+        std::thread thread([&] {
+            coordinator->on_change();
+            done = true;
+        });
+        bool delivered_while_running = false;
+        while (calls[0] == 1) {
+            bool running = !done;
+            r->notify();
+            delivered_while_running = running;
+            std::this_thread::yield();
+        }
+        thread.join();
+
+        REQUIRE(delivered_while_running);
+        for (size_t i = 0; i < results.size(); ++i)
+            REQUIRE(calls[i] == (i == 0 ? 2 : 1));
+        REQUIRE(other_calls == 1);
+
+        r2->notify();
+        REQUIRE(other_calls == 2);
+        REQUIRE(other.size() == large_size);
+    }
+
+    SECTION("removing notifiers releases their worker") {
+        tokens.clear();
+        r->begin_transaction();
+        table->add_empty_row();
+        r->commit_transaction();
+        advance_and_notify(*r);
+
+        for (size_t i = 0; i < results.size(); ++i)
+            REQUIRE(calls[i] == 1);
+    }
+}
+
+TEST_CASE("notifications: dedicated notifier thread") {
+    if (!util::EventLoop::has_implementation())
+        return;
+
+    _impl::RealmCoordinator::assert_no_open_realms();
+
+    InMemoryTestFile config;
+    config.cache = false;
+    config.dedicated_notifier_thread = true;
+    // Hold each run after the first back for long enough that several commits
+    // arrive while the notifier thread is busy with it
+    config.async_notifier_min_interval_ms = 200;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+    });
+
+    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
+    auto table = r->read_group().get_table("class_object");
+
+    Results results(r, *table);
+    int calls = 0;
+    CollectionChangeSet change;
+    auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        ++calls;
+        change = std::move(c);
+    });
+    util::EventLoop::main().run_until([&] { return calls == 1; });
+
+    auto r2 = coordinator->get_realm();
+    auto table2 = r2->read_group().get_table("class_object");
+
+    SECTION("delivers notifications for commits from other Realms") {
+        r2->begin_transaction();
+        table2->add_empty_row();
+        r2->commit_transaction();
+
+        util::EventLoop::main().run_until([&] { return calls == 2; });
+        REQUIRE(results.size() == 1);
+        REQUIRE_INDICES(change.insertions, 0);
+    }
+
+    SECTION("coalesces commits made while a run is in progress") {
+        auto before = coordinator->get_notifier_statistics();
+        const size_t commits = 10;
+        for (size_t i = 0; i < commits; ++i) {
+            r2->begin_transaction();
+            table2->add_empty_row();
+            r2->commit_transaction();
+        }
+
+        util::EventLoop::main().run_until([&] { return results.size() == commits; });
+        auto after = coordinator->get_notifier_statistics();
+        REQUIRE(after.versions - before.versions >= commits);
+        REQUIRE(after.runs - before.runs < commits);
+    }
+
+    SECTION("closing the coordinator joins the notifier thread") {
+        std::weak_ptr<_impl::RealmCoordinator> weak_coordinator = coordinator;
+        token = {};
+        results = {};
+        table2 = {};
+        table = {};
+        r2->close();
+        r->close();
+        r2 = nullptr;
+        r = nullptr;
+        coordinator = nullptr;
+
+        REQUIRE(weak_coordinator.expired());
+        _impl::RealmCoordinator::assert_no_open_realms();
+    }
+}
+
+TEST_CASE("notifications: rate limiting") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.async_notifier_min_interval_ms = 200;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+    });
+
+    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
+    auto table = r->read_group().get_table("class_object");
+
+    Results results(r, table->where());
+    int calls = 0;
+    CollectionChangeSet change;
+    auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        ++calls;
+        change = std::move(c);
+    });
+
+    advance_and_notify(*r);
+    REQUIRE(calls == 1);
+
+    SECTION("commits within the interval are coalesced into a single delayed run") {
+        for (int i = 0; i < 3; ++i) {
+            r->begin_transaction();
+            table->add_empty_row();
+            r->commit_transaction();
+        }
+        advance_and_notify(*r);
+
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(change.insertions, 0, 1, 2);
+
+        auto stats = coordinator->get_notifier_statistics();
+        REQUIRE(stats.runs == 2);
+        REQUIRE(stats.versions >= 3);
+        REQUIRE(stats.delayed_runs == 1);
+        REQUIRE(stats.expedited_runs == 0);
+    }
+
+    SECTION("runs are not delayed after the interval has passed") {
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        r->begin_transaction();
+        table->add_empty_row();
+        r->commit_transaction();
+        advance_and_notify(*r);
+
+        REQUIRE(calls == 2);
+        REQUIRE(coordinator->get_notifier_statistics().delayed_runs == 0);
+    }
+
+    SECTION("adding a callback ends the delay early") {
+        r->begin_transaction();
+        table->add_empty_row();
+        r->commit_transaction();
+
+        // Whether the callback is added before or during the delay, the run
+        // should not wait out the full interval
+        std::thread thread([&] { coordinator->on_change(); });
+        Results results2(r, table->where());
+        auto token2 = results2.add_notification_callback([](CollectionChangeSet, std::exception_ptr) { });
+        thread.join();
+
+        auto stats = coordinator->get_notifier_statistics();
+        REQUIRE(stats.expedited_runs == stats.delayed_runs);
+    }
+}
+
+TEST_CASE("notifications: identical queries") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+    });
+
+    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
+    auto table = r->read_group().get_table("class_object");
+
+    r->begin_transaction();
+    table->add_empty_row(4);
+    for (int i = 0; i < 4; ++i)
+        table->set_int(0, i, 10 - i);
+    r->commit_transaction();
+
+    auto r2 = coordinator->get_realm();
+    auto table2 = r2->read_group().get_table("class_object");
+
+    // Sorted Results for the whole table are identical regardless of which
+    // Realm they're for, so the query is only run once for all of them
+    std::vector<Results> results;
+    results.push_back(Results(r, *table).sort({*table, {{0}}}));
+    results.push_back(Results(r, *table).sort({*table, {{0}}}));
+    results.push_back(Results(r2, *table2).sort({*table2, {{0}}}));
+    results.push_back(Results(r, *table).sort({*table, {{0}}, {false}}));
+
+    std::vector<CollectionChangeSet> changes(results.size());
+    std::vector<NotificationToken> tokens;
+    for (size_t i = 0; i < results.size(); ++i) {
+        tokens.push_back(results[i].add_notification_callback([&, i](CollectionChangeSet c, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            changes[i] = std::move(c);
+        }));
+    }
+    advance_and_notify(*r);
+    advance_and_notify(*r2);
+
+    auto before = coordinator->get_notifier_statistics();
+    r->begin_transaction();
+    table->set_int(0, table->add_empty_row(), 0);
+    r->commit_transaction();
+    advance_and_notify(*r);
+    advance_and_notify(*r2);
+
+    // The query only actually ran for the first of the three identical
+    // Results, and for the one with a different sort order
+    auto after = coordinator->get_notifier_statistics();
+    REQUIRE(after.shared_runs - before.shared_runs == 2);
+
+    for (size_t i = 0; i < 3; ++i) {
+        REQUIRE(results[i].size() == 5);
+        REQUIRE(results[i].get(0).get_int(0) == 0);
+        REQUIRE_INDICES(changes[i].insertions, 0);
+    }
+    REQUIRE(results[3].size() == 5);
+    REQUIRE(results[3].get(0).get_int(0) == 10);
+    REQUIRE_INDICES(changes[3].insertions, 4);
+}
+
+TEST_CASE("notifications: incremental diff") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int},
+            {"order", PropertyType::Int},
+        }},
+    });
+
+    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
+    auto table = r->read_group().get_table("class_object");
+
+    const size_t row_count = 200;
+    r->begin_transaction();
+    table->add_empty_row(row_count);
+    for (size_t i = 0; i < row_count; ++i) {
+        table->set_int(0, i, i);
+        table->set_int(1, i, i);
+    }
+    r->commit_transaction();
+
+    // Sorting on a column which is in table order gives the same results, but
+    // sorted results are always diffed in full
+    Results unsorted(r, table->where().greater_equal(0, 0));
+    Results sorted = Results(r, table->where().greater_equal(0, 0)).sort({*table, {{1}}});
+
+    CollectionChangeSet unsorted_changes, sorted_changes;
+    auto unsorted_token = unsorted.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        unsorted_changes = std::move(c);
+    });
+    auto sorted_token = sorted.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        sorted_changes = std::move(c);
+    });
+    advance_and_notify(*r);
+
+    // Modify the first `count` rows, with every third one no longer matching
+    auto modify = [&](size_t count) {
+        r->begin_transaction();
+        for (size_t i = 0; i < count; ++i)
+            table->set_int(0, i, i % 3 == 0 ? -1 : int64_t(i + row_count));
+        r->commit_transaction();
+
+        auto before = coordinator->get_notifier_statistics();
+        advance_and_notify(*r);
+        return coordinator->get_notifier_statistics().incremental_diffs - before.incremental_diffs;
+    };
+    auto indices = [](IndexSet const& index_set) {
+        auto indexes = index_set.as_indexes();
+        return std::vector<size_t>(indexes.begin(), indexes.end());
+    };
+    auto require_same_changes = [&] {
+        REQUIRE(indices(unsorted_changes.deletions) == indices(sorted_changes.deletions));
+        REQUIRE(indices(unsorted_changes.insertions) == indices(sorted_changes.insertions));
+        REQUIRE(indices(unsorted_changes.modifications) == indices(sorted_changes.modifications));
+        REQUIRE(indices(unsorted_changes.modifications_new) == indices(sorted_changes.modifications_new));
+        REQUIRE(unsorted_changes.moves.empty());
+        REQUIRE(sorted_changes.moves.empty());
+    };
+
+    SECTION("changes to up to half of the rows are calculated incrementally") {
+        REQUIRE(modify(row_count / 2) == 1);
+        REQUIRE(unsorted_changes.deletions.count() == 34);
+        REQUIRE(unsorted_changes.modifications.count() == 66);
+        require_same_changes();
+    }
+
+    SECTION("changes to more than half of the rows are diffed in full") {
+        REQUIRE(modify(row_count / 2 + 1) == 0);
+        REQUIRE(unsorted_changes.deletions.count() == 34);
+        REQUIRE(unsorted_changes.modifications.count() == 67);
+        require_same_changes();
+    }
+
+    SECTION("rows which stop and start matching are spliced in correctly") {
+        REQUIRE(modify(10) == 1);
+        require_same_changes();
+
+        r->begin_transaction();
+        for (size_t i = 0; i < 10; i += 3)
+            table->set_int(0, i, 1);
+        table->set_int(0, 50, -1);
+        r->commit_transaction();
+        advance_and_notify(*r);
+
+        REQUIRE_INDICES(unsorted_changes.insertions, 0, 3, 6, 9);
+        REQUIRE_INDICES(unsorted_changes.deletions, 46);
+        require_same_changes();
+        REQUIRE(unsorted.size() == row_count - 1);
+        for (size_t i = 0; i < unsorted.size(); ++i)
+            REQUIRE(unsorted.get(i).get_index() == sorted.get(i).get_index());
+    }
+}
+
+TEST_CASE("notifications: slow notifier on the same Realm") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"small", {
+            {"value", PropertyType::Int}
+        }},
+        {"large", {
+            {"value", PropertyType::Int}
+        }},
+    });
+
+    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
+    auto small = r->read_group().get_table("class_small");
+    auto large = r->read_group().get_table("class_large");
+
+    const size_t large_size = 100000;
+    r->begin_transaction();
+    small->add_empty_row(5);
+    large->add_empty_row(large_size);
+    for (size_t i = 0; i < large_size; ++i)
+        large->set_int(0, i, large_size - i);
+    r->commit_transaction();
+
+    // The sorted Bulk Results takes much longer to run than the Interactive
+    // one, so the latter is handed over at a newer version well before the
+    // former has caught up
+    Results fast(r, *small);
+    Results slow = Results(r, *large).sort({*large, {{0}}});
+
+    // Each callback's running total of insertions has to match the size of the
+    // Results at the version the Realm was advanced to
+    struct Tracker {
+        int calls = 0;
+        size_t size = 0;
+    };
+    auto track = [](Tracker& tracker, Results& results) {
+        return [&tracker, &results](CollectionChangeSet c, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            if (tracker.calls++ == 0)
+                tracker.size = results.size();
+            else
+                tracker.size += c.insertions.count() - c.deletions.count();
+            REQUIRE(tracker.size == results.size());
+        };
+    };
+    Tracker fast_tracker, slow_tracker;
+    auto fast_token = fast.add_notification_callback(track(fast_tracker, fast));
+    auto slow_token = slow.add_notification_callback(track(slow_tracker, slow), NotificationPriority::Bulk);
+    advance_and_notify(*r);
+    REQUIRE(fast_tracker.calls == 1);
+    REQUIRE(slow_tracker.calls == 1);
+
+    auto add_rows = [&] {
+        r->begin_transaction();
+        small->add_empty_row();
+        large->set_int(0, large->add_empty_row(), large_size + 1);
+        r->commit_transaction();
+    };
+
+    // Leave changes from one run undelivered, then deliver while the next run
+    // is still in progress
+    add_rows();
+    coordinator->on_change();
+    add_rows();
+
+    std::atomic<bool> done{false};
+    std::thread thread([&] {
+        coordinator->on_change();
+        done = true;
+    });
+    while (!done && fast_tracker.calls == 1) {
+        r->notify();
+        std::this_thread::yield();
+    }
+    thread.join();
+    r->notify();
+
+    REQUIRE(fast_tracker.calls == 2);
+    REQUIRE(slow_tracker.calls == 2);
+    REQUIRE(fast_tracker.size == 7);
+    REQUIRE(slow_tracker.size == large_size + 2);
+}
+
+TEST_CASE("notifications: priority") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+    });
+
+    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
+    auto table = r->read_group().get_table("class_object");
+
+    r->begin_transaction();
+    table->add_empty_row(10);
+    for (int i = 0; i < 10; ++i)
+        table->set_int(0, i, i);
+    r->commit_transaction();
+
+    const NotificationPriority priorities[] = {
+        NotificationPriority::Bulk,
+        NotificationPriority::Interactive,
+        NotificationPriority::Background,
+    };
+    std::vector<Results> results;
+    for (int i = 0; i < 3; ++i)
+        results.push_back(Results(r, table->where().greater_equal(0, i)));
+
+    std::vector<int> calls(results.size());
+    std::vector<CollectionChangeSet> changes(results.size());
+    std::vector<NotificationToken> tokens;
+    for (size_t i = 0; i < results.size(); ++i) {
+        tokens.push_back(results[i].add_notification_callback([&, i](CollectionChangeSet c, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            ++calls[i];
+            changes[i] = std::move(c);
+        }, priorities[i]));
+    }
+
+    advance_and_notify(*r);
+    for (size_t i = 0; i < results.size(); ++i)
+        REQUIRE(calls[i] == 1);
+
+    SECTION("notifiers of every priority are delivered together") {
+        r->begin_transaction();
+        table->set_int(0, 1, -1);
+        r->commit_transaction();
+        advance_and_notify(*r);
+
+        REQUIRE(calls[0] == 2);
+        REQUIRE(calls[1] == 2);
+        REQUIRE(calls[2] == 1);
+        REQUIRE_INDICES(changes[0].deletions, 1);
+        REQUIRE_INDICES(changes[1].deletions, 0);
+    }
+
+    SECTION("a notifier with callbacks of several priorities delivers to all of them") {
+        int interactive_calls = 0;
+        CollectionChangeSet interactive_changes;
+        auto token = results[0].add_notification_callback([&](CollectionChangeSet c, std::exception_ptr) {
+            ++interactive_calls;
+            interactive_changes = std::move(c);
+        });
+        advance_and_notify(*r);
+        REQUIRE(interactive_calls == 1);
+
+        r->begin_transaction();
+        table->set_int(0, 0, -1);
+        r->commit_transaction();
+        advance_and_notify(*r);
+
+        REQUIRE(calls[0] == 2);
+        REQUIRE(interactive_calls == 2);
+        REQUIRE_INDICES(changes[0].deletions, 0);
+        REQUIRE_INDICES(interactive_changes.deletions, 0);
+    }
+
+    SECTION("notifiers added at a lower priority are delivered") {
+        Results late(r, table->where().less(0, 5));
+        int late_calls = 0;
+        CollectionChangeSet late_changes;
+        auto late_token = late.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            ++late_calls;
+            late_changes = std::move(c);
+        }, NotificationPriority::Bulk);
+        advance_and_notify(*r);
+        REQUIRE(late_calls == 1);
+        REQUIRE(late.size() == 5);
+
+        r->begin_transaction();
+        table->set_int(0, 9, 0);
+        r->commit_transaction();
+        advance_and_notify(*r);
+        REQUIRE(late_calls == 2);
+        REQUIRE_INDICES(late_changes.insertions, 5);
+    }
+}
+
+TEST_CASE("notifications: diff row limit") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.async_notifier_max_diff_rows = 5;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+    });
+
+    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
+    auto table = r->read_group().get_table("class_object");
+
+    r->begin_transaction();
+    table->add_empty_row(10);
+    for (int i = 0; i < 10; ++i)
+        table->set_int(0, i, i * 10);
+    r->commit_transaction();
+
+    Results results = Results(r, *table).sort({*table, {{0}}});
+    CollectionChangeSet change;
+    auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        change = std::move(c);
+    });
+    advance_and_notify(*r);
+
+    SECTION("small reorderings are diffed normally") {
+        r->begin_transaction();
+        table->set_int(0, 8, 95);
+        r->commit_transaction();
+        advance_and_notify(*r);
+
+        REQUIRE_INDICES(change.deletions, 8);
+        REQUIRE_INDICES(change.insertions, 9);
+    }
+
+    SECTION("reorderings past the limit report every row as replaced") {
+        r->begin_transaction();
+        table->set_int(0, 0, 95);
+        r->commit_transaction();
+        advance_and_notify(*r);
+
+        REQUIRE_INDICES(change.deletions, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9);
+        REQUIRE_INDICES(change.insertions, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9);
+        REQUIRE(change.modifications.empty());
+    }
+}
+
+TEST_CASE("notifications: key path filtering") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"person", {
+            {"name", PropertyType::Int},
+            {"age", PropertyType::Int},
+            {"dog", PropertyType::Object, "dog", "", false, false, true}
+        }},
+        {"dog", {
+            {"name", PropertyType::Int},
+            {"age", PropertyType::Int}
+        }},
+    });
+
+    auto people = r->read_group().get_table("class_person");
+    auto dogs = r->read_group().get_table("class_dog");
+
+    r->begin_transaction();
+    people->add_empty_row(5);
+    dogs->add_empty_row(5);
+    for (size_t i = 0; i < 5; ++i)
+        people->set_link(2, i, i);
+    r->commit_transaction();
+
+    Results results(r, people->where());
+
+    int calls = 0;
+    CollectionChangeSet change;
+    auto callback = [&](CollectionChangeSet c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        change = c;
+        ++calls;
+    };
+    auto write = [&](auto&& f) {
+        r->begin_transaction();
+        f();
+        r->commit_transaction();
+        advance_and_notify(*r);
+    };
+
+    SECTION("modifications to unobserved properties are not reported") {
+        auto token = results.add_notification_callback(callback, {"name"});
+        advance_and_notify(*r);
+        REQUIRE(calls == 1);
+
+        write([&] { people->set_int(1, 1, 10); });
+        REQUIRE(calls == 1);
+        write([&] { dogs->set_int(0, 1, 10); });
+        REQUIRE(calls == 1);
+
+        write([&] { people->set_int(0, 1, 10); });
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(change.modifications, 1);
+    }
+
+    SECTION("modifications to observed properties of linked objects are reported") {
+        auto token = results.add_notification_callback(callback, {"dog.name"});
+        advance_and_notify(*r);
+
+        write([&] { dogs->set_int(1, 2, 10); });
+        REQUIRE(calls == 1);
+        write([&] { people->set_int(0, 2, 10); });
+        REQUIRE(calls == 1);
+
+        write([&] { dogs->set_int(0, 2, 10); });
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(change.modifications, 2);
+
+        write([&] { people->set_link(2, 3, 0); });
+        REQUIRE(calls == 3);
+        REQUIRE_INDICES(change.modifications, 3);
+    }
+
+    SECTION("insertions and deletions are reported regardless of key paths") {
+        auto token = results.add_notification_callback(callback, {"name"});
+        advance_and_notify(*r);
+
+        write([&] { people->add_empty_row(); });
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(change.insertions, 5);
+    }
+
+    SECTION("callbacks with different key paths are sent the union of their modifications") {
+        auto token = results.add_notification_callback(callback, {"name"});
+        int calls2 = 0;
+        auto token2 = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr) {
+            ++calls2;
+        }, {"age"});
+        advance_and_notify(*r);
+
+        write([&] { people->set_int(1, 1, 10); });
+        REQUIRE(calls == 2);
+        REQUIRE(calls2 == 2);
+        write([&] { dogs->set_int(0, 1, 10); });
+        REQUIRE(calls == 2);
+        REQUIRE(calls2 == 2);
+    }
+
+    SECTION("a callback without key paths observes everything") {
+        auto token = results.add_notification_callback(callback, {"name"});
+        auto token2 = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr) { });
+        advance_and_notify(*r);
+
+        write([&] { dogs->set_int(1, 1, 10); });
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(change.modifications, 1);
+    }
+
+    SECTION("queries on unobserved linked properties are still kept up to date") {
+        Results young_dogs(r, people->link(2).column<Int>(1) < 5);
+        auto token = young_dogs.add_notification_callback(callback, {"name"});
+        advance_and_notify(*r);
+        REQUIRE(young_dogs.size() == 5);
+
+        write([&] { dogs->set_int(1, 4, 10); });
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(change.deletions, 4);
+        REQUIRE(young_dogs.size() == 4);
+    }
+
+    SECTION("invalid key paths throw") {
+        REQUIRE_THROWS_AS(results.add_notification_callback(callback, {"nonexistent"}), InvalidPropertyException);
+        REQUIRE_THROWS_AS(results.add_notification_callback(callback, {"name.first"}), InvalidPropertyException);
+        REQUIRE_THROWS_AS(results.add_notification_callback(callback, {"dog.owner"}), InvalidPropertyException);
+    }
+}
+
 #if REALM_PLATFORM_APPLE
 TEST_CASE("notifications: async error handling") {
     _impl::RealmCoordinator::assert_no_open_realms();
@@ -1242,6 +2135,33 @@ TEST_CASE("notifications: results") {
             REQUIRE(change.modifications_new.empty());
         }
 
+        SECTION("appending matching rows marks them as inserted") {
+            write([&] {
+                table->add_empty_row(2);
+                table->set_int(0, 10, 5);
+                table->set_int(0, 11, 20);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.insertions, 4);
+            REQUIRE(change.deletions.empty());
+            REQUIRE(change.modifications.empty());
+        }
+
+        SECTION("multiple modifications in one write are reported together") {
+            write([&] {
+                table->set_int(0, 1, 3);
+                table->set_int(0, 2, 0);
+                table->set_int(0, 7, 1);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.deletions, 1);
+            REQUIRE_INDICES(change.insertions, 3);
+            REQUIRE_INDICES(change.modifications, 0);
+            REQUIRE_INDICES(change.modifications_new, 0);
+            REQUIRE(results.size() == 4);
+            REQUIRE(results.get(3).get_index() == 7);
+        }
+
         SECTION("deleting a matching row marks that row as deleted") {
             write([&] {
                 table->move_last_over(3);
@@ -1638,6 +2558,54 @@ TEST_CASE("notifications: results") {
             REQUIRE_INDICES(change.insertions, 0);
         }
     }
+
+    SECTION("results depending on backlinks") {
+        auto linking_table = r->read_group().get_table("class_linking object");
+        r->begin_transaction();
+        linking_table->add_empty_row();
+        linking_table->set_link(0, 0, 2);
+        r->commit_transaction();
+
+        Results linked(r, table->column<BackLink>(*linking_table, 0).count() > 0);
+
+        int notification_calls = 0;
+        CollectionChangeSet change;
+        auto token = linked.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            change = c;
+            ++notification_calls;
+        });
+        advance_and_notify(*r);
+        REQUIRE(notification_calls == 1);
+        REQUIRE(linked.size() == 1);
+        REQUIRE(linked.get(0).get_index() == 2);
+
+        auto write = [&](auto&& f) {
+            r->begin_transaction();
+            f();
+            r->commit_transaction();
+            advance_and_notify(*r);
+        };
+
+        // Moving the link makes one row leave the results and another enter
+        // without writing to the query's table or changing the size
+        write([&] {
+            linking_table->set_link(0, 0, 5);
+        });
+        REQUIRE(notification_calls == 2);
+        REQUIRE_INDICES(change.deletions, 0);
+        REQUIRE_INDICES(change.insertions, 0);
+        REQUIRE(linked.get(0).get_index() == 5);
+
+        // Later changes are still reported against the new rows
+        write([&] {
+            table->set_int(0, 5, 100);
+        });
+        REQUIRE(notification_calls == 3);
+        REQUIRE(change.deletions.empty());
+        REQUIRE(change.insertions.empty());
+        REQUIRE_INDICES(change.modifications, 0);
+    }
 }
 
 TEST_CASE("results: notifications after move") {
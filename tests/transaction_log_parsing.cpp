@@ -98,7 +98,8 @@ private:
         auto it = util::make_reverse_iterator(info.deletions.end());
         auto end = util::make_reverse_iterator(info.deletions.begin());
         for (; it != end; ++it) {
-            m_initial.erase(m_initial.begin() + it->first, m_initial.begin() + it->second);
+            auto range = *it;
+            m_initial.erase(m_initial.begin() + range.first, m_initial.begin() + range.second);
         }
 
         for (auto const& range : info.insertions) {
@@ -423,6 +424,31 @@ TEST_CASE("Transaction log parsing: changeset calcuation") {
             REQUIRE_INDICES(info.tables[2].modifications, 1);
         }
 
+        SECTION("modified columns are only tracked when requested") {
+            auto info = track_changes({false, false, true}, [&] {
+                table.set_int(1, 1, 2);
+            });
+            REQUIRE_INDICES(info.tables[2].modifications, 1);
+            REQUIRE(info.tables[2].columns.empty());
+
+            auto history = make_in_realm_history(config.path);
+            SharedGroup sg(*history, config.options());
+            sg.begin_read();
+
+            r->begin_transaction();
+            table.set_int(1, 2, 3);
+            r->commit_transaction();
+
+            _impl::TransactionChangeInfo info2{};
+            info2.table_modifications_needed = {false, false, true};
+            info2.table_columns_needed = {false, false, true};
+            _impl::transaction::advance(sg, info2);
+            REQUIRE_INDICES(info2.tables[2].modifications, 2);
+            REQUIRE(info2.tables[2].columns.size() == 2);
+            REQUIRE(info2.tables[2].columns[0].empty());
+            REQUIRE_INDICES(info2.tables[2].columns[1], 2);
+        }
+
         SECTION("modifications to untracked tables are ignored") {
             auto info = track_changes({false, false, false}, [&] {
                 table.set_int(0, 1, 2);
@@ -2074,6 +2100,87 @@ TEST_CASE("DeepChangeChecker") {
         CHECK(checker3(19));
     }
 
+    SECTION("modified_rows() checks a batch of rows") {
+        r->begin_transaction();
+        table->add_empty_row(10);
+        for (int i = 0; i < 19; ++i)
+            table->set_link(1, i, i + 1);
+        table->get_linklist(3, 0)->add(18);
+        r->commit_transaction();
+
+        auto info = track_changes([&] {
+            table->set_int(0, 19, -1);
+        });
+
+        std::vector<size_t> rows;
+        for (size_t i = 0; i < 20; ++i)
+            rows.push_back(19 - i);
+        rows.push_back(4);
+
+        // Row 0 is within the depth limit via the linklist even though the
+        // chain of links is too long, and rows 1-3 are not
+        auto modified = _impl::DeepChangeChecker(info, *table, tables).modified_rows(rows);
+        REQUIRE(modified.contains(0));
+        REQUIRE_FALSE(modified.contains(1));
+        REQUIRE_FALSE(modified.contains(2));
+        REQUIRE_FALSE(modified.contains(3));
+        for (size_t i = 4; i < 20; ++i)
+            REQUIRE(modified.contains(i));
+        REQUIRE(modified.count() == 17);
+    }
+
+    SECTION("modifications calculated via backlinks match searching forward") {
+        r->begin_transaction();
+        table->add_empty_row(10);
+        for (int i = 0; i < 19; ++i)
+            table->set_link(1, i, i + 1);
+        table->set_link(2, 5, 5);
+        table->get_linklist(3, 0)->add(18);
+        table->get_linklist(3, 2)->add(2);
+        table->get_linklist(3, 2)->add(12);
+        r->commit_transaction();
+
+        auto info = track_changes([&] {
+            table->set_int(0, 19, -1);
+        });
+        auto precalculated = info;
+        _impl::DeepChangeChecker::calculate_modified_via_links(precalculated, r->read_group());
+        REQUIRE(precalculated.modified_via_links_calculated);
+
+        _impl::DeepChangeChecker forward(info, *table, tables);
+        _impl::DeepChangeChecker backward(precalculated, *table, tables);
+        for (size_t i = 0; i < table->size(); ++i) {
+            CAPTURE(i);
+            REQUIRE(forward(i) == backward(i));
+        }
+        // 3 is too many links away from 19, while 1 can reach it via 2's list
+        REQUIRE(backward(0));
+        REQUIRE(backward(1));
+        REQUIRE(backward(2));
+        REQUIRE_FALSE(backward(3));
+        REQUIRE(backward(4));
+    }
+
+    SECTION("modifications via backlinks are only calculated on demand when requested") {
+        r->begin_transaction();
+        for (int i = 0; i < 9; ++i)
+            table->set_link(1, i, i + 1);
+        r->commit_transaction();
+
+        auto info = track_changes([&] {
+            table->set_int(0, 9, -1);
+        });
+        _impl::DeepChangeChecker::ensure_modified_via_links(info, r->read_group());
+        REQUIRE_FALSE(info.modified_via_links_calculated);
+
+        info.modified_via_links_mutex = std::make_shared<std::mutex>();
+        _impl::DeepChangeChecker::ensure_modified_via_links(info, r->read_group());
+        REQUIRE(info.modified_via_links_calculated);
+        _impl::DeepChangeChecker checker(info, *table, tables);
+        for (size_t i = 0; i < 10; ++i)
+            REQUIRE(checker(i));
+    }
+
     SECTION("targets moving is not a change") {
         r->begin_transaction();
         table->set_link(1, 0, 9);